@@ -0,0 +1,210 @@
+/*
+  NAME:
+  Benchmark of two-wire bus operations of DS1307 chip using gbjDS1307 library.
+
+  DESCRIPTION:
+  The sketch measures the average duration of particular library methods,
+  which communicate with the chip, and displays it in microseconds along with
+  number of bus transactions and bytes they generate.
+  - The listed transactions and bytes correspond to the implementation of the
+    library and serve as a baseline for evaluation of its changes. Each
+    transaction consists of START condition, address byte, and register
+    pointer or data bytes, and is terminated by STOP or repeated START.
+  - The listed transactions and bytes are counted on the simulated chip by the
+    host tests in the folder "test" of the library.
+  - The sketch retains the date and time of the chip, so that it writes
+    recently read values back to the chip at measuring setters.
+  - The sketch uses the first byte of non-volatile memory of the chip.
+  - Connect modul's pins to microcontroller's I2C bus as described in README.md
+    for used platform accordingly.
+
+  LICENSE:
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the MIT License (MIT).
+
+  CREDENTIALS:
+  Author: Libor Gabaj
+*/
+#include "gbj_ds1307.h"
+
+const unsigned int ROUNDS = 100;
+const unsigned int POSITION = 0;
+
+gbj_ds1307 device = gbj_ds1307();
+// gbj_ds1307 device = gbj_ds1307(device.CLOCK_400KHZ);
+// gbj_ds1307 device = gbj_ds1307(device.CLOCK_100KHZ, D2, D1);
+gbj_ds1307::Datetime rtcDateTime;
+char rtcText[gbj_ds1307::DATETIME_SIZE];
+byte valueByte;
+unsigned long valueEpoch;
+unsigned long timeStart;
+
+void errorHandler(String location)
+{
+  Serial.println(device.getLastErrorTxt(location));
+  Serial.println("---");
+  return;
+}
+
+void startMeasure() { timeStart = micros(); }
+
+void stopMeasure(String location, byte transactions, byte bytes)
+{
+  unsigned long duration = (micros() - timeStart) / ROUNDS;
+  Serial.print(location);
+  Serial.print(": ");
+  Serial.print(duration);
+  Serial.print(" us, ");
+  Serial.print(transactions);
+  Serial.print(" transactions, ");
+  Serial.print(bytes);
+  Serial.println(" bytes");
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  Serial.println("---");
+
+  // Initialize
+  if (device.isError(device.begin()))
+  {
+    errorHandler("Begin");
+    return;
+  }
+  if (device.isError(device.getDateTime(rtcDateTime)))
+  {
+    errorHandler("Datetime read");
+    return;
+  }
+
+  startMeasure();
+  for (unsigned int i = 0; i < ROUNDS; i++)
+  {
+    device.begin();
+  }
+  stopMeasure("begin()", 2, 1 + 8);
+
+  startMeasure();
+  for (unsigned int i = 0; i < ROUNDS; i++)
+  {
+    device.getDateTime(rtcDateTime);
+  }
+  stopMeasure("getDateTime()", 2, 1 + 8);
+
+  device.setVerifyRead(true);
+  startMeasure();
+  for (unsigned int i = 0; i < ROUNDS; i++)
+  {
+    device.getDateTime(rtcDateTime);
+  }
+  stopMeasure("getDateTime() verified", 2, 1 + 8);
+  device.setVerifyRead(false);
+
+  startMeasure();
+  for (unsigned int i = 0; i < ROUNDS; i++)
+  {
+    device.getSeconds(valueByte);
+  }
+  stopMeasure("getSeconds()", 2, 1 + 1);
+
+  startMeasure();
+  for (unsigned int i = 0; i < ROUNDS; i++)
+  {
+    device.getTimeOfDay(rtcDateTime);
+  }
+  stopMeasure("getTimeOfDay()", 2, 1 + 3);
+
+  startMeasure();
+  for (unsigned int i = 0; i < ROUNDS; i++)
+  {
+    device.readConfiguration();
+  }
+  stopMeasure("readConfiguration()", 2, 1 + 1);
+
+  startMeasure();
+  for (unsigned int i = 0; i < ROUNDS; i++)
+  {
+    device.getEpoch(valueEpoch);
+  }
+  stopMeasure("getEpoch()", 2, 1 + 8);
+
+  startMeasure();
+  for (unsigned int i = 0; i < ROUNDS; i++)
+  {
+    device.sleep();
+    device.wake();
+    device.getEpoch(valueEpoch);
+  }
+  stopMeasure("sleep() + wake() + getEpoch()", 2, 1 + 8);
+
+  // Conversions without bus communication
+  startMeasure();
+  for (unsigned int i = 0; i < ROUNDS; i++)
+  {
+    device.convertDateTime(rtcDateTime);
+  }
+  stopMeasure("convertDateTime()", 0, 0);
+
+  startMeasure();
+  for (unsigned int i = 0; i < ROUNDS; i++)
+  {
+    valueEpoch = device.convertEpoch();
+  }
+  stopMeasure("convertEpoch()", 0, 0);
+
+  startMeasure();
+  for (unsigned int i = 0; i < ROUNDS; i++)
+  {
+    device.getDateTime(rtcText, device.DATETIME_ISO);
+  }
+  stopMeasure("getDateTime(char*)", 2, 1 + 8);
+
+  startMeasure();
+  for (unsigned int i = 0; i < ROUNDS; i++)
+  {
+    gbj_ds1307::parseIso(rtcDateTime, rtcText);
+  }
+  stopMeasure("parseIso()", 0, 0);
+
+  device.getDateTime(rtcDateTime);
+  startMeasure();
+  for (unsigned int i = 0; i < ROUNDS; i++)
+  {
+    device.setDateTime(rtcDateTime);
+  }
+  stopMeasure("setDateTime()", 1, 1 + 7);
+
+  startMeasure();
+  for (unsigned int i = 0; i < ROUNDS; i++)
+  {
+    device.stopClock();
+    device.startClock();
+  }
+  stopMeasure("stopClock() + startClock()", 3 + 1, (1 + 1 + 2) + 2);
+
+  startMeasure();
+  for (unsigned int i = 0; i < ROUNDS; i++)
+  {
+    device.startSqw(device.SQW_RATE_1HZ);
+    device.startSqw(device.SQW_RATE_32KHZ);
+  }
+  stopMeasure("startSqw() x 2", 2 * 1, 2 * 2);
+
+  startMeasure();
+  for (unsigned int i = 0; i < ROUNDS; i++)
+  {
+    device.retrieve(POSITION, valueByte);
+  }
+  stopMeasure("retrieve(byte)", 2, 1 + 1);
+
+  startMeasure();
+  for (unsigned int i = 0; i < ROUNDS; i++)
+  {
+    device.store(POSITION, valueByte);
+  }
+  stopMeasure("store(byte)", 1, 1 + 1);
+  Serial.println("---");
+}
+
+void loop() {}
@@ -21,6 +21,7 @@ gbj_ds1307 device = gbj_ds1307();
 // gbj_ds1307 device = gbj_ds1307(device.CLOCK_400KHZ);
 // gbj_ds1307 device = gbj_ds1307(device.CLOCK_100KHZ, D2, D1);
 gbj_ds1307::Datetime rtcDateTime;
+char rtcText[gbj_ds1307::DATETIME_SIZE];
 
 void errorHandler(String location)
 {
@@ -69,6 +70,15 @@ void setup()
   Serial.print(rtcDateTime.mode12h ? "12" : "24");
   Serial.println(" hours");
   Serial.println("---");
+  // Formatted datetime without dynamic memory allocation
+  if (device.isError(device.getDateTime(rtcText, device.DATETIME_RFC3339)))
+  {
+    errorHandler("Datetime format");
+    return;
+  }
+  Serial.print("RFC 3339: ");
+  Serial.println(rtcText);
+  Serial.println("---");
 }
 
 void loop() {}
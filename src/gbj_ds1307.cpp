@@ -1,32 +1,380 @@
 #include "gbj_ds1307.h"
 
+gbj_ds1307 *gbj_ds1307::sqwDevice_ = nullptr;
+
+#if defined(ESP8266) || defined(ESP32)
+IRAM_ATTR
+#endif
+void gbj_ds1307::isrSqw()
+{
+  sqwDevice_->sqwTicks_++;
+}
+
 void gbj_ds1307::convertDateTime(Datetime &dtRecord)
 {
-  dtRecord.second = bcd2bin(rtcRecord_.second & ~(1 << SecondBits::CONFIG_CH));
-  dtRecord.minute = bcd2bin(rtcRecord_.minute);
-  dtRecord.hour = bcd2bin(rtcRecord_.hour);
-  dtRecord.mode12h =
-    static_cast<bool>(rtcRecord_.hour & (1 << HourBits::CONFIG_12H));
-  dtRecord.pm = static_cast<bool>(rtcRecord_.hour & (1 << HourBits::CONFIG_PM));
-  if (dtRecord.mode12h)
+  convertTime(dtRecord);
+  dtRecord.day = FieldDay::decode(rtcRecord_.day);
+  dtRecord.month = FieldMonth::decode(rtcRecord_.month);
+  dtRecord.year = FieldYear::decode(rtcRecord_.year) + 2000;
+  dtRecord.weekday = FieldWeekday::decode(rtcRecord_.weekday);
+}
+
+void gbj_ds1307::convertTime(Datetime &dtRecord)
+{
+  uint8_t hour = rtcRecord_.hour;
+  dtRecord.second = FieldSecond::decode(rtcRecord_.second);
+  dtRecord.minute = FieldMinute::decode(rtcRecord_.minute);
+  dtRecord.mode12h = static_cast<bool>(hour & (1 << HourBits::CONFIG_12H));
+  dtRecord.pm = static_cast<bool>(hour & (1 << HourBits::CONFIG_PM));
+  dtRecord.hour = dtRecord.mode12h ? FieldHour12::decode(hour)
+                                   : FieldHour24::decode(hour);
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::getDateTime(char *buffer,
+                                                DatetimeFormats format)
+{
+  if (isError(refreshRtcRecord()))
+  {
+    return getLastResult();
+  }
+  RtcRecord record = rtcRecord_;
+  if (driftPpb_ != 0)
+  {
+    advanceRtcRecord(-getDriftCorrection(convertEpoch()));
+  }
+  formatRtcRecord(buffer, format);
+  rtcRecord_ = record;
+  return getLastResult();
+}
+
+void gbj_ds1307::formatRtcRecord(char *buffer, DatetimeFormats format)
+{
+  bool extended = format != DatetimeFormats::DATETIME_COMPACT;
+  uint8_t hour = rtcRecord_.hour;
+  if (hour & (1 << HourBits::CONFIG_12H))
+  {
+    uint8_t hour24 = FieldHour12::decode(hour) % 12;
+    if (hour & (1 << HourBits::CONFIG_PM))
+    {
+      hour24 += 12;
+    }
+    hour = bin2bcd(hour24);
+  }
+  *buffer++ = '2';
+  *buffer++ = '0';
+  buffer = formatBcd(buffer, FieldYear::digits(rtcRecord_.year));
+  if (extended)
+  {
+    *buffer++ = '-';
+  }
+  buffer = formatBcd(buffer, FieldMonth::digits(rtcRecord_.month));
+  if (extended)
+  {
+    *buffer++ = '-';
+  }
+  buffer = formatBcd(buffer, FieldDay::digits(rtcRecord_.day));
+  if (extended)
+  {
+    *buffer++ = 'T';
+  }
+  buffer = formatBcd(buffer, FieldHour24::digits(hour));
+  if (extended)
+  {
+    *buffer++ = ':';
+  }
+  buffer = formatBcd(buffer, FieldMinute::digits(rtcRecord_.minute));
+  if (extended)
+  {
+    *buffer++ = ':';
+  }
+  buffer = formatBcd(buffer, FieldSecond::digits(rtcRecord_.second));
+  if (format == DatetimeFormats::DATETIME_RFC3339)
+  {
+    if (timezone_ == 0)
+    {
+      *buffer++ = 'Z';
+    }
+    else
+    {
+      uint16_t offset = timezone_ < 0 ? -timezone_ : timezone_;
+      *buffer++ = timezone_ < 0 ? '-' : '+';
+      buffer = formatBcd(buffer, bin2bcd(offset / 60));
+      *buffer++ = ':';
+      buffer = formatBcd(buffer, bin2bcd(offset % 60));
+    }
+  }
+  *buffer = '\0';
+}
+
+uint8_t gbj_ds1307::crc8(const uint8_t *buffer, uint8_t len)
+{
+  uint8_t crc = 0xFF;
+  while (len--)
+  {
+    crc ^= *buffer++;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+      crc = crc & 0x01 ? (crc >> 1) ^ 0x8C : crc >> 1;
+    }
+  }
+  return crc;
+}
+
+bool gbj_ds1307::parseIso(Datetime &dtRecord, const char *strIso)
+{
+  for (uint8_t i = 0; i < 19; i++)
+  {
+    if (strIso[i] == '\0')
+    {
+      return false;
+    }
+  }
+  // Positions of digits pairs and separators in YYYY-MM-DDTHH:MM:SS
+  if (strIso[4] != '-' || strIso[7] != '-' ||
+      (strIso[10] != 'T' && strIso[10] != ' ') || strIso[13] != ':' ||
+      strIso[16] != ':' || parseDigits(strIso) != 20)
+  {
+    return false;
+  }
+  uint8_t year = parseDigits(strIso + 2);
+  uint8_t month = parseDigits(strIso + 5);
+  uint8_t day = parseDigits(strIso + 8);
+  uint8_t hour = parseDigits(strIso + 11);
+  uint8_t minute = parseDigits(strIso + 14);
+  uint8_t second = parseDigits(strIso + 17);
+  if (year > 99 || month < 1 || month > 12 || day < 1 || day > 31 ||
+      hour > 23 || minute > 59 || second > 59)
   {
-    rtcRecord_.hour &= ~(1 << HourBits::CONFIG_12H);
-    rtcRecord_.hour &= ~(1 << HourBits::CONFIG_PM);
-    dtRecord.hour = bcd2bin(rtcRecord_.hour);
+    return false;
   }
-  dtRecord.day = bcd2bin(rtcRecord_.day);
-  dtRecord.month = bcd2bin(rtcRecord_.month);
-  dtRecord.year = bcd2bin(rtcRecord_.year) + 2000;
-  dtRecord.weekday = rtcRecord_.weekday;
+  // Leap years of 21th century are those divisible by 4
+  const uint8_t monthDays[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+  if (day > monthDays[month - 1] + (month == 2 && year % 4 == 0))
+  {
+    return false;
+  }
+  dtRecord.year = 2000 + year;
+  dtRecord.month = month;
+  dtRecord.day = day;
+  dtRecord.hour = hour;
+  dtRecord.minute = minute;
+  dtRecord.second = second;
+  dtRecord.mode12h = false;
+  dtRecord.pm = false;
+  // 1970-01-01 was Thursday
+  dtRecord.weekday = (daysFromCivil(2000 + year, month, day) + 3) % 7 + 1;
+  return true;
 }
 
 gbj_ds1307::ResultCodes gbj_ds1307::setDateTime(const Datetime &dtRecord)
 {
-  Commands command = Commands::CMD_REG_SECOND;
+  encodeDateTime(dtRecord);
+  // Chip's time keeping registers move on, so that write them all
+  dirtyTimeRegisters();
+  cacheValid_ = isSuccess(commit());
+  return getLastResult();
+}
+
+void gbj_ds1307::configDateTime(const Datetime &dtRecord)
+{
+  RtcRecord origRecord = rtcRecord_;
+  uint8_t *origItems = reinterpret_cast<uint8_t *>(&origRecord);
+  uint8_t *items = reinterpret_cast<uint8_t *>(&rtcRecord_);
+  encodeDateTime(dtRecord);
+  for (uint8_t reg = Commands::CMD_REG_SECOND; reg < Commands::CMD_REG_CONTROL;
+       reg++)
+  {
+    if (!cacheValid_ || items[reg] != origItems[reg])
+    {
+      rtcDirty_ |= 1 << reg;
+      if (reg == Commands::CMD_REG_SECOND)
+      {
+        rtcDirtySecond_ = 0xFF;
+      }
+    }
+  }
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::commit()
+{
+  if (rtcDirty_ == 0)
+  {
+    return setLastResult();
+  }
+  GBJ_DS1307_STATS_SCOPE(STATS_REGISTERS_WRITE);
+  uint8_t regFirst = Commands::CMD_REG_SECOND;
+  uint8_t regLast = Commands::CMD_REG_CONTROL;
+  while (!(rtcDirty_ & (1 << regFirst)))
+  {
+    regFirst++;
+  }
+  while (!(rtcDirty_ & (1 << regLast)))
+  {
+    regLast--;
+  }
+  if (isError(
+        writeRegisters(regFirst,
+                       reinterpret_cast<uint8_t *>(&rtcRecord_) + regFirst,
+                       regLast - regFirst + 1)))
+  {
+    if (regFirst < Commands::CMD_REG_CONTROL)
+    {
+      cacheValid_ = clockKnown_ = false;
+    }
+    return getLastResult();
+  }
+  rtcDirty_ = rtcDirtySecond_ = 0;
+  // Written seconds restart the cache
+  if (regFirst == Commands::CMD_REG_SECOND)
+  {
+    clockKnown_ = true;
+    anchorCache();
+  }
+  // Written time starts new drift measurement interval
+  if (regFirst < Commands::CMD_REG_CONTROL &&
+      driftPosition_ < Memory::MEMORY_SIZE)
+  {
+    driftEpoch_ = convertEpoch();
+    return storeDrift();
+  }
+  return getLastResult();
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::beginDrift(uint8_t position)
+{
+  uint8_t record[Memory::DRIFT_SIZE];
+  if (isError(retrieveNvram(position, record, sizeof(record))))
+  {
+    return getLastResult();
+  }
+  driftPosition_ = position;
+  driftEpoch_ = 0;
+  driftPpb_ = 0;
+  if (record[0] != Params::PARAM_DRIFT_MAGIC ||
+      crc8(record, sizeof(record) - 1) != record[sizeof(record) - 1])
+  {
+    return getLastResult();
+  }
+  uint32_t epoch;
+  int32_t drift;
+  memcpy(&epoch, record + 1, sizeof(epoch));
+  memcpy(&drift, record + 1 + sizeof(epoch), sizeof(drift));
+  // Years 2000 ~ 2099
+  if (epoch < 946684800UL || epoch > 4102444799UL)
+  {
+    return getLastResult();
+  }
+  driftEpoch_ = epoch;
+  driftPpb_ = constrain(drift, -Params::PARAM_DRIFT_MAX, Params::PARAM_DRIFT_MAX);
+  return getLastResult();
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::storeDrift()
+{
+  uint8_t record[Memory::DRIFT_SIZE];
+  record[0] = Params::PARAM_DRIFT_MAGIC;
+  memcpy(record + 1, &driftEpoch_, sizeof(driftEpoch_));
+  memcpy(record + 1 + sizeof(driftEpoch_), &driftPpb_, sizeof(driftPpb_));
+  record[sizeof(record) - 1] = crc8(record, sizeof(record) - 1);
+  if (isError(storeNvram(driftPosition_, record, sizeof(record))))
+  {
+    return getLastResult();
+  }
+  return flushNvram();
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::syncEpoch(uint32_t reference)
+{
+  if (isError(readRtcRecord()))
+  {
+    return getLastResult();
+  }
+  if (driftPosition_ < Memory::MEMORY_SIZE && driftEpoch_ > 0 &&
+      reference > driftEpoch_ &&
+      reference - driftEpoch_ > Params::PARAM_DRIFT_PERIOD)
+  {
+    int32_t deviation = convertEpoch() - reference;
+    int32_t drift = static_cast<int64_t>(deviation) * 1000000000L /
+                    static_cast<int32_t>(reference - driftEpoch_);
+    drift = driftPpb_ == 0 ? drift : driftPpb_ + (drift - driftPpb_) / 4;
+    driftPpb_ =
+      constrain(drift, -Params::PARAM_DRIFT_MAX, Params::PARAM_DRIFT_MAX);
+  }
+  return setEpoch(reference);
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::startClock(const BcdDatetime &bcdDateTime,
+                                               uint8_t weekday,
+                                               bool mode12h)
+{
+  rtcRecord_.second = bcdDateTime.second;
+  rtcRecord_.minute = bcdDateTime.minute;
+  rtcRecord_.hour = mode12h ? bcdDateTime.hour12 : bcdDateTime.hour;
+  rtcRecord_.weekday = constrain(weekday, 1, 7);
+  rtcRecord_.day = bcdDateTime.day;
+  rtcRecord_.month = bcdDateTime.month;
+  rtcRecord_.year = bcdDateTime.year;
+  dirtyTimeRegisters();
+  cacheValid_ = isSuccess(commit());
+  return getLastResult();
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::switchClock(bool enable)
+{
+  GBJ_DS1307_STATS_SCOPE(STATS_REGISTERS_WRITE);
+  bool origBusStop = getBusStop();
+  // Seconds of known halted clock do not change
+  if (!clockKnown_ || getClockEnabled() ||
+      (rtcDirty_ & (1 << Commands::CMD_REG_SECOND)))
+  {
+    uint8_t second;
+    cacheValid_ = false;
+    setBusRepeat();
+    clockKnown_ =
+      isSuccess(readRegisters(Commands::CMD_REG_SECOND, &second, 1));
+    setBusStopFlag(origBusStop);
+    if (!clockKnown_)
+    {
+      return getLastResult();
+    }
+    // Clock halt bit follows the chip, changed seconds are kept
+    rtcDirtySecond_ &= ~(1 << SecondBits::CONFIG_CH);
+    if (rtcDirtySecond_ == 0)
+    {
+      rtcDirty_ &= ~(1 << Commands::CMD_REG_SECOND);
+    }
+    mergeRtcRecord(Commands::CMD_REG_SECOND, &second, 1);
+  }
+  if (getClockEnabled() == enable)
+  {
+    return setLastResult();
+  }
+  if (enable)
+  {
+    configClockEnable();
+  }
+  else
+  {
+    configClockDisable();
+  }
+  if (isError(writeRegisters(Commands::CMD_REG_SECOND, &rtcRecord_.second, 1)))
+  {
+    cacheValid_ = clockKnown_ = false;
+    return getLastResult();
+  }
+  rtcDirty_ &= ~(1 << Commands::CMD_REG_SECOND);
+  rtcDirtySecond_ = 0;
+  // Halted clock has been started right now
+  anchorCache();
+  return getLastResult();
+}
+
+void gbj_ds1307::encodeDateTime(const Datetime &dtRecord)
+{
   // Retain original clock halt bit
   rtcRecord_.second &= 1 << SecondBits::CONFIG_CH;
-  rtcRecord_.second |= bin2bcd(dtRecord.second % 60);
-  rtcRecord_.minute = bin2bcd(dtRecord.minute % 60);
+  rtcRecord_.second |= FieldSecond::encode(dtRecord.second % 60);
+  rtcRecord_.minute = FieldMinute::encode(dtRecord.minute % 60);
   rtcRecord_.hour = 0;
   if (dtRecord.mode12h)
   {
@@ -38,21 +386,879 @@ gbj_ds1307::ResultCodes gbj_ds1307::setDateTime(const Datetime &dtRecord)
       rtcRecord_.hour |= (1 << HourBits::CONFIG_PM);
     }
     rtcRecord_.hour |=
-      bin2bcd(dtRecord.hour % 12 == 0 ? 12 : dtRecord.hour % 12);
+      FieldHour12::encode(dtRecord.hour % 12 == 0 ? 12 : dtRecord.hour % 12);
   }
   else
   {
-    rtcRecord_.hour |= bin2bcd(dtRecord.hour % 24);
+    rtcRecord_.hour |= FieldHour24::encode(dtRecord.hour % 24);
   }
-  rtcRecord_.day = bin2bcd(constrain(dtRecord.day, 1, 31));
-  rtcRecord_.month = bin2bcd(constrain(dtRecord.month, 1, 12));
-  rtcRecord_.year = bin2bcd(dtRecord.year % 100);
+  rtcRecord_.day = FieldDay::encode(constrain(dtRecord.day, 1, 31));
+  rtcRecord_.month = FieldMonth::encode(constrain(dtRecord.month, 1, 12));
+  rtcRecord_.year = FieldYear::encode(dtRecord.year % 100);
   rtcRecord_.weekday = constrain(dtRecord.weekday, 1, 7);
-  return (busSendStreamPrefixed(reinterpret_cast<uint8_t *>(&rtcRecord_),
-                                sizeof(rtcRecord_),
-                                false,
-                                reinterpret_cast<uint8_t *>(&command),
-                                sizeof(command),
-                                false,
-                                true));
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::attachSqw(uint8_t pin)
+{
+  // The only interrupt handler serves just one device
+  if (sqwDevice_ != nullptr && sqwDevice_ != this)
+  {
+    return setLastResult(ResultCodes::ERROR_PINS);
+  }
+  if (isError(startSqw(SquareWaveFrequency::SQW_RATE_1HZ)))
+  {
+    return getLastResult();
+  }
+  detachSqw();
+  sqwDevice_ = this;
+  pinMode(pin, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(pin), isrSqw, FALLING);
+  // Wait for the first edge right after the chip's second increment
+  uint16_t ticks = getSqwTicks();
+  uint32_t timestamp = millis();
+  while (ticks == getSqwTicks() && millis() - timestamp < 1100)
+  {
+    yield();
+  }
+  if (isError(readRtcRecord()))
+  {
+    detachInterrupt(digitalPinToInterrupt(pin));
+    sqwDevice_ = nullptr;
+    return getLastResult();
+  }
+  sqwPin_ = pin;
+  return getLastResult();
+}
+
+void gbj_ds1307::detachSqw()
+{
+  if (getSqwAttached())
+  {
+    detachInterrupt(digitalPinToInterrupt(sqwPin_));
+    sqwPin_ = Params::PARAM_NOPIN;
+  }
+  if (sqwDevice_ == this)
+  {
+    sqwDevice_ = nullptr;
+  }
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::syncTimestamp()
+{
+  GBJ_DS1307_STATS_SCOPE(STATS_PARTIAL_READ);
+  uint32_t timestamp = millis();
+  if (getSqwAttached())
+  {
+    // Halted clock generates no square wave signal
+    if (clockKnown_ && !getClockEnabled())
+    {
+      return setLastResult(ResultCodes::ERROR_RCV_DATA);
+    }
+    uint16_t ticks = getSqwTicks();
+    while (ticks == getSqwTicks() && millis() - timestamp < 1100)
+    {
+      yield();
+    }
+    if (ticks == getSqwTicks())
+    {
+      return setLastResult(ResultCodes::ERROR_RCV_DATA);
+    }
+    stampMicros_ = micros();
+    if (isError(refreshRtcRecord()))
+    {
+      return getLastResult();
+    }
+  }
+  else
+  {
+    uint8_t secondOrig, second;
+    if (isError(readRegisters(Commands::CMD_REG_SECOND, &secondOrig, 1)))
+    {
+      cacheValid_ = clockKnown_ = false;
+      return getLastResult();
+    }
+    // Halted clock never increments seconds
+    if (secondOrig & (1 << SecondBits::CONFIG_CH))
+    {
+      return setLastResult(ResultCodes::ERROR_RCV_DATA);
+    }
+    do
+    {
+      if (isError(readRegisters(Commands::CMD_REG_SECOND, &second, 1)))
+      {
+        cacheValid_ = clockKnown_ = false;
+        return getLastResult();
+      }
+    } while (second == secondOrig && millis() - timestamp < 1100);
+    if (second == secondOrig)
+    {
+      return setLastResult(ResultCodes::ERROR_RCV_DATA);
+    }
+    stampMicros_ = micros();
+    if (isError(readRtcRecord()))
+    {
+      return getLastResult();
+    }
+  }
+  stampEpoch_ = convertEpoch();
+  return getLastResult();
+}
+
+uint64_t gbj_ds1307::getTimestamp()
+{
+  uint32_t elapsed = micros() - stampMicros_;
+  // Move the anchor by whole seconds for preventing microseconds overflow
+  if (elapsed >= 1000000UL)
+  {
+    uint32_t seconds = elapsed / 1000000UL;
+    stampEpoch_ += seconds;
+    stampMicros_ += seconds * 1000000UL;
+    elapsed -= seconds * 1000000UL;
+  }
+  uint64_t timestamp = static_cast<uint64_t>(stampEpoch_) * 1000000UL + elapsed;
+  if (timestamp < stampLast_)
+  {
+    return stampLast_;
+  }
+  stampLast_ = timestamp;
+  return timestamp;
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::begin(const BootState &state)
+{
+  if (isError(beginBus()))
+  {
+    return getLastResult();
+  }
+  busTuned_ = state.busTuned;
+  if (busTuned_)
+  {
+    setBusClock(ClockSpeeds::CLOCK_400KHZ);
+  }
+  if (isError(loadNvramMirror()))
+  {
+    return getLastResult();
+  }
+  // Time keeping registers are read at first datetime reading
+  rtcRecord_ = {};
+  rtcRecord_.second = state.second & (1 << SecondBits::CONFIG_CH);
+  rtcRecord_.hour = state.hour & (1 << HourBits::CONFIG_12H);
+  rtcRecord_.control = state.control;
+  rtcDirty_ = rtcDirtySecond_ = 0;
+  cacheValid_ = clockKnown_ = false;
+  return getLastResult();
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::sleep()
+{
+  if (isError(flushNvram()))
+  {
+    return getLastResult();
+  }
+  asyncState_ = AsyncStates::ASYNC_IDLE;
+#if !defined(ESP8266)
+  Wire.end();
+#endif
+  return getLastResult();
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::wake()
+{
+  if (isError(beginBus()))
+  {
+    return getLastResult();
+  }
+  if (busTuned_)
+  {
+    setBusClock(ClockSpeeds::CLOCK_400KHZ);
+  }
+  // Neither system time nor square wave edges might have been counted in sleep
+  cacheValid_ = false;
+  return getLastResult();
+}
+
+bool gbj_ds1307::poll()
+{
+  switch (asyncState_)
+  {
+    case AsyncStates::ASYNC_IDLE:
+      return true;
+
+    case AsyncStates::ASYNC_POINTER:
+    {
+      if (cacheValid_ &&
+          (getSqwAttached() || millis() - cacheSynced_ < cachePeriod_))
+      {
+        refreshRtcRecord();
+        break;
+      }
+      GBJ_DS1307_STATS_SCOPE(STATS_ASYNC_READ);
+      if (isError(trackBusClock(busSend(Commands::CMD_REG_SECOND))))
+      {
+        cacheValid_ = clockKnown_ = false;
+        break;
+      }
+      GBJ_DS1307_STATS_BYTES(0, 1);
+      asyncState_ = AsyncStates::ASYNC_RECEIVE;
+      return false;
+    }
+
+    case AsyncStates::ASYNC_RECEIVE:
+    {
+      GBJ_DS1307_STATS_SCOPE(STATS_ASYNC_READ);
+      if (isError(trackBusClock(
+            busReceive(reinterpret_cast<uint8_t *>(&asyncRecord_),
+                       sizeof(asyncRecord_)))))
+      {
+        cacheValid_ = clockKnown_ = false;
+        break;
+      }
+      GBJ_DS1307_STATS_BYTES(sizeof(asyncRecord_), 0);
+      if (!verifyRead_)
+      {
+        acceptAsyncRecord(true);
+        break;
+      }
+      if (checkRtcRecord(asyncRecord_))
+      {
+        // Carry during reading is possible only after seconds 59 of running
+        // clock
+        if ((asyncRecord_.second & (1 << SecondBits::CONFIG_CH)) ||
+            FieldSecond::decode(asyncRecord_.second) != 59)
+        {
+          acceptAsyncRecord(true);
+          break;
+        }
+        asyncState_ = AsyncStates::ASYNC_VERIFY;
+        return false;
+      }
+      if (acceptAsyncRecord(false))
+      {
+        return false;
+      }
+      break;
+    }
+
+    case AsyncStates::ASYNC_VERIFY:
+    {
+      GBJ_DS1307_STATS_SCOPE(STATS_ASYNC_READ);
+      uint8_t second;
+      if (isError(readRegisters(Commands::CMD_REG_SECOND, &second, 1)))
+      {
+        cacheValid_ = clockKnown_ = false;
+        break;
+      }
+      if (acceptAsyncRecord(second == asyncRecord_.second))
+      {
+        return false;
+      }
+      break;
+    }
+  }
+  // Reading completed
+  asyncState_ = AsyncStates::ASYNC_IDLE;
+  if (asyncHandler_ != nullptr)
+  {
+    asyncHandler_();
+  }
+  return true;
+}
+
+bool gbj_ds1307::acceptAsyncRecord(bool valid)
+{
+  if (valid)
+  {
+    cacheValid_ = clockKnown_ = true;
+    mergeRtcRecord(Commands::CMD_REG_SECOND,
+                   reinterpret_cast<uint8_t *>(&asyncRecord_),
+                   sizeof(asyncRecord_));
+    anchorCache();
+    return false;
+  }
+  GBJ_DS1307_STATS_INVALID();
+  // Inconsistent registers must not be cached
+  cacheValid_ = clockKnown_ = false;
+  if (--asyncAttempts_ == 0)
+  {
+    setLastResult(ResultCodes::ERROR_RCV_DATA);
+    return false;
+  }
+  asyncState_ = AsyncStates::ASYNC_POINTER;
+  return true;
+}
+
+bool gbj_ds1307::Batch::add(uint8_t reg,
+                            uint8_t *buffer,
+                            uint8_t len,
+                            bool write)
+{
+  // Register pointer of the chip would wrap to the seconds register
+  if (reg + len > Commands::CMD_REG_RAM_MAX + 1)
+  {
+    return false;
+  }
+  if (count_ > 0)
+  {
+    Item &item = items_[count_ - 1];
+    if (item.write == write && item.reg + item.len == reg &&
+        item.buffer + item.len == buffer)
+    {
+      item.len += len;
+      return true;
+    }
+  }
+  if (count_ >= Params::BATCH_SIZE)
+  {
+    return false;
+  }
+  items_[count_++] = { buffer, reg, len, write };
+  return true;
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::runBatch(Batch &batch)
+{
+  GBJ_DS1307_STATS_SCOPE(STATS_BATCH);
+  bool origBusStop = getBusStop();
+  setLastResult();
+  for (uint8_t i = 0; i < batch.count_; i++)
+  {
+    Batch::Item &item = batch.items_[i];
+    // Repeated start between operations
+    if (i < batch.count_ - 1)
+    {
+      setBusRepeat();
+    }
+    else
+    {
+      setBusStopFlag(origBusStop);
+    }
+    // Time keeping registers read to the cache keep its changed registers
+    bool cached = !item.write &&
+                  item.buffer == reinterpret_cast<uint8_t *>(&rtcRecord_);
+    RtcRecord record;
+    if (item.write)
+    {
+      writeRegisters(item.reg, item.buffer, item.len);
+    }
+    else
+    {
+      readRegisters(item.reg,
+                    cached ? reinterpret_cast<uint8_t *>(&record) + item.reg
+                           : item.buffer,
+                    item.len);
+    }
+    if (isError(getLastResult()))
+    {
+      cacheValid_ = clockKnown_ = false;
+      break;
+    }
+    if (item.write)
+    {
+      syncBatchWrite(item);
+    }
+    if (cached)
+    {
+      mergeRtcRecord(item.reg,
+                     reinterpret_cast<uint8_t *>(&record) + item.reg,
+                     item.len);
+      if (item.reg == Commands::CMD_REG_SECOND &&
+          item.len >= Commands::CMD_REG_CONTROL)
+      {
+        cacheValid_ = clockKnown_ = true;
+        anchorCache();
+      }
+    }
+  }
+  setBusStopFlag(origBusStop);
+  batch.clear();
+  return getLastResult();
+}
+
+void gbj_ds1307::syncBatchWrite(const Batch::Item &item)
+{
+  uint8_t regEnd = item.reg + item.len;
+  // Written time keeping registers make the cache stale
+  if (item.reg < Commands::CMD_REG_CONTROL)
+  {
+    cacheValid_ = false;
+    if (item.reg == Commands::CMD_REG_SECOND)
+    {
+      clockKnown_ = false;
+    }
+  }
+  // Written control register is cached and not pending anymore
+  if (item.reg <= Commands::CMD_REG_CONTROL &&
+      regEnd > Commands::CMD_REG_CONTROL)
+  {
+    rtcRecord_.control = item.buffer[Commands::CMD_REG_CONTROL - item.reg];
+    rtcDirty_ &= ~(1 << Commands::CMD_REG_CONTROL);
+  }
+  // Written memory is mirrored
+  if (nvramMirror_ != nullptr && regEnd > Commands::CMD_REG_RAM_MIN)
+  {
+    uint8_t regFirst = Commands::CMD_REG_RAM_MIN;
+    if (item.reg > regFirst)
+    {
+      regFirst = item.reg;
+    }
+    memcpy(nvramMirror_ + regFirst - Commands::CMD_REG_RAM_MIN,
+           item.buffer + regFirst - item.reg,
+           regEnd - regFirst);
+  }
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::readRtcRecord()
+{
+  GBJ_DS1307_STATS_SCOPE(STATS_DATETIME_READ);
+  RtcRecord record;
+  uint8_t attempts = Params::PARAM_VERIFY_READS;
+  while (isSuccess(readRegisters(Commands::CMD_REG_SECOND,
+                                 reinterpret_cast<uint8_t *>(&record),
+                                 sizeof(record))) &&
+         verifyRead_)
+  {
+    if (checkRtcRecord(record))
+    {
+      // Carry during reading is possible only after seconds 59 of running
+      // clock
+      if ((record.second & (1 << SecondBits::CONFIG_CH)) ||
+          FieldSecond::decode(record.second) != 59)
+      {
+        break;
+      }
+      uint8_t second;
+      if (isError(readRegisters(Commands::CMD_REG_SECOND, &second, 1)) ||
+          second == record.second)
+      {
+        break;
+      }
+    }
+    GBJ_DS1307_STATS_INVALID();
+    // Inconsistent registers must not be cached
+    if (--attempts == 0)
+    {
+      setLastResult(ResultCodes::ERROR_RCV_DATA);
+      break;
+    }
+  }
+  cacheValid_ = clockKnown_ = isSuccess(getLastResult());
+  if (cacheValid_)
+  {
+    mergeRtcRecord(Commands::CMD_REG_SECOND,
+                   reinterpret_cast<uint8_t *>(&record),
+                   sizeof(record));
+  }
+  anchorCache();
+  return getLastResult();
+}
+
+void gbj_ds1307::mergeRtcRecord(uint8_t reg,
+                                const uint8_t *buffer,
+                                uint8_t len)
+{
+  uint8_t *items = reinterpret_cast<uint8_t *>(&rtcRecord_);
+  for (; len > 0; reg++, buffer++, len--)
+  {
+    // Bits kept from the cache
+    uint8_t mask = 0x00;
+    if (rtcDirty_ & (1 << reg))
+    {
+      mask = reg == Commands::CMD_REG_SECOND ? rtcDirtySecond_ : 0xFF;
+    }
+    items[reg] = (items[reg] & mask) | (*buffer & ~mask);
+  }
+}
+
+bool gbj_ds1307::checkRtcRecord(const RtcRecord &record)
+{
+  const uint8_t *reg = reinterpret_cast<const uint8_t *>(&record);
+  bool mode12h = record.hour & (1 << HourBits::CONFIG_12H);
+  // BCD digits, flag bits, and ranges of time keeping registers
+  const uint8_t digits[] = {
+    0x7F, 0x7F, static_cast<uint8_t>(mode12h ? 0x1F : 0x3F), 0x07, 0x3F, 0x1F,
+    0xFF
+  };
+  const uint8_t flags[] = { 0x80, 0x00, 0x60, 0x00, 0x00, 0x00, 0x00 };
+  const uint8_t lows[] = { 0, 0, mode12h, 1, 1, 1, 0 };
+  const uint8_t highs[] = {
+    59, 59, static_cast<uint8_t>(mode12h ? 12 : 23), 7, 31, 12, 99
+  };
+  for (uint8_t i = Commands::CMD_REG_SECOND; i < Commands::CMD_REG_CONTROL;
+       i++)
+  {
+    uint8_t value = reg[i] & digits[i];
+    if ((reg[i] & ~(digits[i] | flags[i])) || (value & 0x0F) > 9 ||
+        (value >> 4) > 9)
+    {
+      return false;
+    }
+    value = bcd2bin(value);
+    if (value < lows[i] || value > highs[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::refreshRtcRecord()
+{
+  if (getSqwAttached() && cacheValid_)
+  {
+    uint16_t ticks = getSqwTicks() - sqwTicksRead_;
+    if (ticks > 0)
+    {
+      sqwTicksRead_ += ticks;
+      advanceRtcRecord(ticks);
+    }
+    return setLastResult();
+  }
+  if (!cacheValid_ || millis() - cacheSynced_ >= cachePeriod_)
+  {
+    return readRtcRecord();
+  }
+  // Extrapolate just whole seconds and keep the rest for next time
+  uint32_t elapsed = (millis() - cacheTimestamp_) / 1000;
+  if (elapsed > 0)
+  {
+    cacheTimestamp_ += elapsed * 1000;
+    // Halted clock does not move on
+    if (getClockEnabled())
+    {
+      advanceRtcRecord(elapsed);
+    }
+  }
+  return setLastResult();
+}
+
+void gbj_ds1307::advanceRtcRecord(int32_t seconds)
+{
+  uint32_t timestamp = convertSeconds();
+  uint8_t weekday = rtcRecord_.weekday;
+  int32_t days = timestamp / 86400UL;
+  timestamp += seconds;
+  encodeSeconds(timestamp);
+  // Retain weekdays sequence of an application
+  days = static_cast<int32_t>(timestamp / 86400UL) - days;
+  rtcRecord_.weekday = ((weekday - 1 + days % 7) % 7 + 7) % 7 + 1;
+}
+
+uint32_t gbj_ds1307::convertSeconds()
+{
+  uint8_t hour = rtcRecord_.hour;
+  if (hour & (1 << HourBits::CONFIG_12H))
+  {
+    hour = FieldHour12::decode(hour) % 12 +
+           (hour & (1 << HourBits::CONFIG_PM) ? 12 : 0);
+  }
+  else
+  {
+    hour = FieldHour24::decode(hour);
+  }
+  uint32_t days = daysFromCivil(FieldYear::decode(rtcRecord_.year) + 2000,
+                                FieldMonth::decode(rtcRecord_.month),
+                                FieldDay::decode(rtcRecord_.day));
+  return FieldSecond::decode(rtcRecord_.second) +
+         60UL * (FieldMinute::decode(rtcRecord_.minute) + 60UL * hour) +
+         86400UL * days;
+}
+
+void gbj_ds1307::encodeSeconds(uint32_t timestamp)
+{
+  uint32_t days = timestamp / 86400UL;
+  timestamp %= 86400UL;
+  uint8_t hour = timestamp / 3600;
+  // Retain original clock halt bit
+  rtcRecord_.second &= 1 << SecondBits::CONFIG_CH;
+  rtcRecord_.second |= FieldSecond::encode(timestamp % 60);
+  rtcRecord_.minute = FieldMinute::encode((timestamp / 60) % 60);
+  // Retain original hours mode
+  if (getClockMode12H())
+  {
+    rtcRecord_.hour = (1 << HourBits::CONFIG_12H) |
+                      (hour >= 12 ? 1 << HourBits::CONFIG_PM : 0) |
+                      FieldHour12::encode(hour % 12 == 0 ? 12 : hour % 12);
+  }
+  else
+  {
+    rtcRecord_.hour = FieldHour24::encode(hour);
+  }
+  // ISO weekday from Monday, 1970-01-01 was Thursday
+  rtcRecord_.weekday = (days + 3) % 7 + 1;
+  uint16_t year;
+  uint8_t month, day;
+  civilFromDays(days, year, month, day);
+  rtcRecord_.day = FieldDay::encode(day);
+  rtcRecord_.month = FieldMonth::encode(month);
+  rtcRecord_.year = FieldYear::encode(year % 100);
+}
+
+void gbj_ds1307::civilFromDays(uint32_t days,
+                               uint16_t &year,
+                               uint8_t &month,
+                               uint8_t &day)
+{
+  // Days shifted to eras from March 0000, so that a leap day is the last one
+  days += 719468UL;
+  uint32_t dayOfEra = days % 146097UL;
+  uint16_t yearOfEra =
+    (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+  uint16_t dayOfYear = dayOfEra - (365UL * yearOfEra + yearOfEra / 4 -
+                                   yearOfEra / 100);
+  uint8_t monthShifted = (5 * dayOfYear + 2) / 153;
+  month = monthShifted < 10 ? monthShifted + 3 : monthShifted - 9;
+  year = yearOfEra + 400 * (days / 146097UL) + (month <= 2);
+  day = dayOfYear - (153 * monthShifted + 2) / 5 + 1;
+}
+
+uint32_t gbj_ds1307::daysFromCivil(uint16_t year, uint8_t month, uint8_t day)
+{
+  // Years starting in March, so that a leap day is the last one
+  year -= month <= 2;
+  uint16_t yearOfEra = year % 400;
+  uint16_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 +
+                       day - 1;
+  uint32_t dayOfEra = 365UL * yearOfEra + yearOfEra / 4 - yearOfEra / 100 +
+                      dayOfYear;
+  return 146097UL * (year / 400) + dayOfEra - 719468UL;
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::readRegisters(uint8_t reg,
+                                                  uint8_t *buffer,
+                                                  uint8_t len)
+{
+  bool origBusStop = getBusStop();
+  movePointer();
+  while (len > 0)
+  {
+    uint8_t burst = len;
+    if (burst > Params::PARAM_BURST_READ)
+    {
+      burst = Params::PARAM_BURST_READ;
+    }
+    setBusRepeat();
+    if (isError(busSend(reg)))
+    {
+      setBusStopFlag(origBusStop);
+      break;
+    }
+    GBJ_DS1307_STATS_BYTES(0, 1);
+    setBusStopFlag(origBusStop);
+    if (isError(busReceive(buffer, burst)))
+    {
+      break;
+    }
+    GBJ_DS1307_STATS_BYTES(burst, 0);
+    reg += burst;
+    buffer += burst;
+    len -= burst;
+  }
+  return trackBusClock(getLastResult());
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::writeRegisters(uint8_t reg,
+                                                   const uint8_t *buffer,
+                                                   uint8_t len)
+{
+  movePointer();
+  while (len > 0)
+  {
+    uint8_t burst = len;
+    if (burst > Params::PARAM_BURST_WRITE)
+    {
+      burst = Params::PARAM_BURST_WRITE;
+    }
+    if (isError(busSendStreamPrefixed(const_cast<uint8_t *>(buffer),
+                                      burst,
+                                      false,
+                                      &reg,
+                                      sizeof(reg),
+                                      false,
+                                      true)))
+    {
+      break;
+    }
+    GBJ_DS1307_STATS_BYTES(0, 1 + burst);
+    reg += burst;
+    buffer += burst;
+    len -= burst;
+  }
+  return trackBusClock(getLastResult());
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::tuneBusClock()
+{
+  uint8_t reference[Memory::MEMORY_SIZE];
+  uint8_t sample[Memory::MEMORY_SIZE];
+  busTuned_ = false;
+  setBusClock(ClockSpeeds::CLOCK_100KHZ);
+  if (isError(readRegisters(
+        Commands::CMD_REG_RAM_MIN, reference, Memory::MEMORY_SIZE)))
+  {
+    return getLastResult();
+  }
+  setBusClock(ClockSpeeds::CLOCK_400KHZ);
+  for (uint8_t i = 0; i < Params::PARAM_TUNE_READS; i++)
+  {
+    if (isError(readRegisters(
+          Commands::CMD_REG_RAM_MIN, sample, Memory::MEMORY_SIZE)) ||
+        memcmp(sample, reference, Memory::MEMORY_SIZE) != 0)
+    {
+      setBusClock(ClockSpeeds::CLOCK_100KHZ);
+      return setLastResult();
+    }
+  }
+  busTuned_ = true;
+  busErrors_ = 0;
+  return getLastResult();
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::storeNvram(uint32_t position,
+                                               const uint8_t *buffer,
+                                               uint8_t len)
+{
+  if (position + len > Memory::MEMORY_SIZE)
+  {
+    return setLastResult(ResultCodes::ERROR_POSITION);
+  }
+  if (nvramMirror_ == nullptr)
+  {
+    GBJ_DS1307_STATS_SCOPE(STATS_NVRAM_WRITE);
+    return writeRegisters(Commands::CMD_REG_RAM_MIN + position, buffer, len);
+  }
+  for (uint8_t i = 0; i < len; i++)
+  {
+    uint8_t *item = nvramMirror_ + position + i;
+    if (*item != buffer[i])
+    {
+      *item = buffer[i];
+      if (!getNvramDirty())
+      {
+        nvramTimestamp_ = millis();
+      }
+      if (nvramDirtyFirst_ > position + i)
+      {
+        nvramDirtyFirst_ = position + i;
+      }
+      if (nvramDirtyLast_ < position + i)
+      {
+        nvramDirtyLast_ = position + i;
+      }
+    }
+  }
+  return flushNvram(false);
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::retrieveNvram(uint32_t position,
+                                                  uint8_t *buffer,
+                                                  uint8_t len)
+{
+  if (position + len > Memory::MEMORY_SIZE)
+  {
+    return setLastResult(ResultCodes::ERROR_POSITION);
+  }
+  if (nvramMirror_ == nullptr)
+  {
+    GBJ_DS1307_STATS_SCOPE(STATS_NVRAM_READ);
+    return readRegisters(Commands::CMD_REG_RAM_MIN + position, buffer, len);
+  }
+  memcpy(buffer, nvramMirror_ + position, len);
+  return setLastResult();
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::flushNvram(bool force)
+{
+  if (!getNvramDirty() ||
+      (!force &&
+       (nvramDeadline_ == 0 || millis() - nvramTimestamp_ < nvramDeadline_)))
+  {
+    return setLastResult();
+  }
+  GBJ_DS1307_STATS_SCOPE(STATS_NVRAM_WRITE);
+  if (isError(writeRegisters(Commands::CMD_REG_RAM_MIN + nvramDirtyFirst_,
+                             nvramMirror_ + nvramDirtyFirst_,
+                             nvramDirtyLast_ - nvramDirtyFirst_ + 1)))
+  {
+    return getLastResult();
+  }
+  nvramDirtyFirst_ = Memory::MEMORY_SIZE;
+  nvramDirtyLast_ = 0;
+  return getLastResult();
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::snapshot(uint8_t *image)
+{
+  if (isError(flushNvram()))
+  {
+    return getLastResult();
+  }
+  image[0] = Params::PARAM_IMAGE_MAGIC1;
+  image[1] = Params::PARAM_IMAGE_MAGIC2;
+  image[2] = Params::PARAM_IMAGE_VERSION;
+  uint8_t *regs = image + 3;
+  GBJ_DS1307_STATS_SCOPE(STATS_BATCH);
+  cacheValid_ = isSuccess(readRegisters(Commands::CMD_REG_SECOND,
+                                        regs,
+                                        Commands::CMD_REG_RAM_MAX + 1));
+  clockKnown_ = cacheValid_;
+  if (cacheValid_)
+  {
+    mergeRtcRecord(Commands::CMD_REG_SECOND, regs, sizeof(rtcRecord_));
+    anchorCache();
+  }
+  return getLastResult();
+}
+
+gbj_ds1307::ResultCodes gbj_ds1307::restore(const uint8_t *image, bool clock)
+{
+  if (image[0] != Params::PARAM_IMAGE_MAGIC1 ||
+      image[1] != Params::PARAM_IMAGE_MAGIC2 ||
+      image[2] != Params::PARAM_IMAGE_VERSION)
+  {
+    return setLastResult(ResultCodes::ERROR_POSITION);
+  }
+  const uint8_t *regs = image + 3;
+  uint8_t regFirst =
+    clock ? Commands::CMD_REG_SECOND : Commands::CMD_REG_CONTROL;
+  {
+    GBJ_DS1307_STATS_SCOPE(STATS_BATCH);
+    if (isError(writeRegisters(regFirst,
+                               regs + regFirst,
+                               Commands::CMD_REG_RAM_MAX + 1 - regFirst)))
+    {
+      cacheValid_ = cacheValid_ && !clock;
+      clockKnown_ = clockKnown_ && !clock;
+      return getLastResult();
+    }
+  }
+  memcpy(reinterpret_cast<uint8_t *>(&rtcRecord_) + regFirst,
+         regs + regFirst,
+         sizeof(rtcRecord_) - regFirst);
+  // Skipped time keeping registers stay pending
+  rtcDirty_ &= (1 << regFirst) - 1;
+  if (!(rtcDirty_ & (1 << Commands::CMD_REG_SECOND)))
+  {
+    rtcDirtySecond_ = 0;
+  }
+  if (nvramMirror_ != nullptr)
+  {
+    memcpy(nvramMirror_,
+           regs + Commands::CMD_REG_RAM_MIN,
+           Memory::MEMORY_SIZE);
+    nvramDirtyFirst_ = Memory::MEMORY_SIZE;
+    nvramDirtyLast_ = 0;
+  }
+  if (!clock)
+  {
+    return getLastResult();
+  }
+  cacheValid_ = clockKnown_ = true;
+  anchorCache();
+  // Written time starts new drift measurement interval
+  if (driftPosition_ < Memory::MEMORY_SIZE)
+  {
+    driftEpoch_ = convertEpoch();
+    return storeDrift();
+  }
+  return getLastResult();
 }
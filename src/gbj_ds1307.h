@@ -24,6 +24,31 @@
 #include "gbj_apphelpers.h"
 #include "gbj_memory.h"
 
+// Size of the two-wire bus buffer taken from the Wire library of a platform
+// included by the parent library, the smallest common one if it does not
+// publish it, overridable by a build flag
+#ifndef GBJ_DS1307_WIRE_BUFFER
+  #if defined(I2C_BUFFER_LENGTH)
+    #define GBJ_DS1307_WIRE_BUFFER I2C_BUFFER_LENGTH
+  #elif defined(BUFFER_LENGTH)
+    #define GBJ_DS1307_WIRE_BUFFER BUFFER_LENGTH
+  #else
+    #define GBJ_DS1307_WIRE_BUFFER 32
+  #endif
+#endif
+
+// Statistics of operations on the two-wire bus, if defined for the whole build
+#ifdef GBJ_DS1307_STATS
+  #define GBJ_DS1307_STATS_SCOPE(operation)                                    \
+    StatsScope statsScope(this, StatsOperations::operation)
+  #define GBJ_DS1307_STATS_BYTES(in, out) statsBytes(in, out)
+  #define GBJ_DS1307_STATS_INVALID() stats_[statsOperation_].invalid++
+#else
+  #define GBJ_DS1307_STATS_SCOPE(operation)
+  #define GBJ_DS1307_STATS_BYTES(in, out)
+  #define GBJ_DS1307_STATS_INVALID()
+#endif
+
 class gbj_ds1307 : public gbj_memory
 {
 public:
@@ -43,8 +68,209 @@ public:
     // 32768 Hz
     SQW_RATE_32KHZ = B11,
   };
+  // Text formats of datetime
+  enum DatetimeFormats : uint8_t
+  {
+    // ISO 8601 extended, e.g., 2024-01-31T13:45:30
+    DATETIME_ISO,
+    // Digits only, e.g., 20240131134530
+    DATETIME_COMPACT,
+    // RFC 3339 with offset of the time zone, e.g., 2024-01-31T13:45:30+01:00
+    DATETIME_RFC3339,
+  };
+  enum Formatting : uint8_t
+  {
+    // Size of a buffer for datetime text in any format
+    DATETIME_SIZE = 26,
+  };
+#ifdef GBJ_DS1307_STATS
+  // Operations with separate statistics
+  enum StatsOperations : uint8_t
+  {
+    // Reading of all time keeping registers
+    STATS_DATETIME_READ,
+    // Reading of particular registers
+    STATS_PARTIAL_READ,
+    // Step of asynchronous reading
+    STATS_ASYNC_READ,
+    // Writing of time keeping or control registers
+    STATS_REGISTERS_WRITE,
+    // Reading of non-volatile memory
+    STATS_NVRAM_READ,
+    // Writing of non-volatile memory
+    STATS_NVRAM_WRITE,
+    // Batch of operations or image of the chip
+    STATS_BATCH,
+    // Number of operations
+    STATS_OPERATIONS,
+  };
+  // Error counters of an operation
+  enum StatsErrors : uint8_t
+  {
+    // No acknowledge of data
+    STATS_ERROR_NACK_DATA,
+    // Wrong or unresponsive address
+    STATS_ERROR_ADDR,
+    // Wrong pins of the bus or square wave signal
+    STATS_ERROR_PINS,
+    // Missing or invalid received data
+    STATS_ERROR_RCV_DATA,
+    // Wrong memory position or record
+    STATS_ERROR_POSITION,
+    // Any other error
+    STATS_ERROR_OTHER,
+    // Number of error counters
+    STATS_ERRORS,
+  };
+  // Statistics of an operation
+  struct Stats
+  {
+    uint32_t calls;
+    uint32_t bytesIn;
+    uint32_t bytesOut;
+    // Latencies in microseconds, average is latencySum / calls
+    uint32_t latencyMin;
+    uint32_t latencyMax;
+    uint32_t latencySum;
+    // Readings with invalid or inconsistent datetime
+    uint16_t invalid;
+    // Errors indexed by error counter
+    uint16_t errors[StatsErrors::STATS_ERRORS];
+  };
+#endif
+  enum Memory : uint8_t
+  {
+    // Size of non-volatile memory in bytes
+    MEMORY_SIZE = 56,
+    // Size of drift record in non-volatile memory in bytes
+    DRIFT_SIZE = 10,
+    // Size of snapshot image of all registers and memory in bytes
+    IMAGE_SIZE = 3 + 64,
+  };
   // External datetime structure
   using Datetime = gbj_apphelpers::Datetime;
+  // Handler of completed asynchronous operation
+  using Handler = void (*)();
+  /*
+    Queue of register space operations.
+
+    DESCRIPTION:
+    The class collects reads and writes of spans of the chip's register space
+    0x00 ~ 0x3F for running them by the method runBatch() in one bus session.
+    - An operation directly following the recent one in the same direction
+    both in register space and in memory is merged with it.
+    - An operation exceeding the register space is rejected, because the
+    register pointer of the chip would wrap to the seconds register.
+    - Registers 0x00 ~ 0x07 are time keeping and control registers, registers
+    0x08 ~ 0x3F are the non-volatile memory.
+  */
+  class Batch
+  {
+  public:
+    enum Params : uint8_t
+    {
+      // Maximal number of operations in a batch
+      BATCH_SIZE = 8,
+    };
+    inline bool read(uint8_t reg, uint8_t *buffer, uint8_t len)
+    {
+      return add(reg, buffer, len, false);
+    }
+    inline bool write(uint8_t reg, const uint8_t *buffer, uint8_t len)
+    {
+      return add(reg, const_cast<uint8_t *>(buffer), len, true);
+    }
+    inline void clear() { count_ = 0; }
+    inline uint8_t getCount() { return count_; }
+
+  private:
+    friend class gbj_ds1307;
+    struct Item
+    {
+      uint8_t *buffer;
+      uint8_t reg;
+      uint8_t len;
+      bool write;
+    } items_[BATCH_SIZE];
+    uint8_t count_ = 0;
+    bool add(uint8_t reg, uint8_t *buffer, uint8_t len, bool write);
+  };
+  /*
+    State of the device for fast start.
+
+    DESCRIPTION:
+    The structure holds the configuration of the chip needed right after start,
+    i.e., control register, clock halt bit, 12 hours mode bit, and the tuned
+    bus clock flag. The application can persist it in a memory surviving the
+    restart of the microcontroller, e.g., RTC memory of ESP, and start the
+    device with it without reading the chip.
+  */
+  struct BootState
+  {
+    uint8_t control;
+    uint8_t second;
+    uint8_t hour;
+    bool busTuned;
+  };
+  /*
+    Datetime encoded to time keeping registers at compile time.
+
+    DESCRIPTION:
+    The structure is a literal type constructed from compilation date and time
+    strings in form of __DATE__ and __TIME__ macros, so that a constexpr
+    variable of it holds BCD values of time keeping registers without any
+    parsing at runtime.
+  */
+  struct BcdDatetime
+  {
+    uint8_t second;
+    uint8_t minute;
+    uint8_t hour;
+    uint8_t hour12;
+    uint8_t day;
+    uint8_t month;
+    uint8_t year;
+    constexpr BcdDatetime(const char *strDate, const char *strTime)
+      : second(bcdDigits(strTime + 6))
+      , minute(bcdDigits(strTime + 3))
+      , hour(bcdDigits(strTime))
+      , hour12(bcdHour12(bcdDigits(strTime)))
+      , day(bcdDigits(strDate + 4))
+      , month(bcdMonth(strDate))
+      , year(bcdDigits(strDate + 9))
+    {
+    }
+
+  private:
+    // Two digits with leading space as in __DATE__
+    static constexpr uint8_t bcdDigits(const char *str)
+    {
+      return ((str[0] == ' ' ? 0 : str[0] - '0') << 4) | (str[1] - '0');
+    }
+    // Month abbreviation as in __DATE__
+    static constexpr uint8_t bcdMonth(const char *str)
+    {
+      return str[0] == 'J'   ? (str[1] == 'a'   ? 0x01
+                                : str[2] == 'n' ? 0x06
+                                                : 0x07)
+             : str[0] == 'F' ? 0x02
+             : str[0] == 'M' ? (str[2] == 'r' ? 0x03 : 0x05)
+             : str[0] == 'A' ? (str[1] == 'p' ? 0x04 : 0x08)
+             : str[0] == 'S' ? 0x09
+             : str[0] == 'O' ? 0x10
+             : str[0] == 'N' ? 0x11
+                             : 0x12;
+    }
+    // Hours register in 12 hours mode from BCD hours in 24 hours mode
+    static constexpr uint8_t bcdHour12(uint8_t bcdHour)
+    {
+      return (1 << HourBits::CONFIG_12H) |
+             (bcdHour >= 0x12 ? 1 << HourBits::CONFIG_PM : 0) |
+             (bcdHour == 0x00   ? 0x12
+              : bcdHour <= 0x12 ? bcdHour
+                                : bin2bcd(bcd2bin(bcdHour) - 12));
+    }
+  };
 
   gbj_ds1307(ClockSpeeds clockSpeed = ClockSpeeds::CLOCK_100KHZ,
              uint8_t pinSDA = 4,
@@ -52,6 +278,8 @@ public:
     : gbj_memory(clockSpeed, pinSDA, pinSCL)
   {
   }
+  // Release of the square wave signal interrupt for another device
+  ~gbj_ds1307() { detachSqw(); }
 
   /*
     Initialize two wire bus and device with parameters stored by constructor.
@@ -59,6 +287,10 @@ public:
     DESCRIPTION:
     The method sanitizes and stores input parameters to the class instance
     object, which determines the operation modus of the device.
+    - If the memory mirror has been set, the method loads whole non-volatile
+    memory to it.
+    - If the bus clock tuning has been enabled, the method calibrates the bus
+    clock frequency before any other communication.
 
     PARAMETERS: none
 
@@ -66,67 +298,649 @@ public:
   */
   inline ResultCodes begin()
   {
-    if (isError(gbj_memory::begin(Commands::CMD_REG_RAM_MAX,
-                                  Commands::CMD_REG_RAM_MAX -
-                                    Commands::CMD_REG_RAM_MIN + 1,
-                                  Commands::CMD_REG_RAM_MIN)))
+    if (isError(beginBus()))
+    {
+      return getLastResult();
+    }
+    if (busTuning_ && isError(tuneBusClock()))
+    {
+      return getLastResult();
+    }
+    if (isError(loadNvramMirror()))
+    {
+      return getLastResult();
+    }
+    return readRtcRecord();
+  }
+
+  /*
+    Initialize two wire bus and device with persisted state.
+
+    DESCRIPTION:
+    The method initializes the device in the same way as the method begin(),
+    but it trusts the provided state instead of reading time keeping and
+    control registers of the chip, so that it saves the bus communication at
+    every restart of the microcontroller.
+    - The datetime cache is invalid, so that the first datetime reading
+    communicates with the chip. The method convertDateTime() cannot be used
+    before it.
+    - The bus clock is not calibrated again. If the state has been obtained
+    with tuned bus clock, the fast clock is set right away.
+    - If the memory mirror has been set, the method loads it anyway.
+
+    PARAMETERS:
+    state - Referenced state obtained by the method getBootState() before the
+    restart.
+      - Data type: BootState
+      - Default value: none
+      - Limited range: address space
+
+    RETURN: Result code
+  */
+  ResultCodes begin(const BootState &state);
+
+  /*
+    Convert internal structure to datetime.
+
+    DESCRIPTION:
+    The method converts already read datetime from the chip and stored in
+    instance internal structure to the referenced external structure (datetime
+    record).
+    - The method converts recently read datetime from the chip without repeating
+      the reading from it. It is useful right after begin() method, which reads
+      the chip's status in either case.
+    - The method expects 21th century, so that adds 2000 to the read two-digit
+    year number.
+
+    PARAMETERS:
+    dtRecord - Referenced structure variable for writing date and time.
+      - Data type: Datetime
+      - Default value: none
+      - Limited range: address space
+
+    RETURN: none
+  */
+  void convertDateTime(Datetime &dtRecord);
+
+  /*
+    Parse datetime in ISO 8601 format.
+
+    DESCRIPTION:
+    The method parses the datetime text in the format YYYY-MM-DDTHH:MM:SS to
+    the referenced external structure (datetime record) for the method
+    setDateTime() without any dynamic memory allocation.
+    - The date and time may be separated by a space instead of 'T'.
+    - Characters after seconds, e.g., fraction of a second or offset, are
+    ignored.
+    - The method sets 24 hours mode and ISO weekday, i.e., Monday is 1 and
+    Sunday is 7.
+    - The day is checked against the length of the month including leap years,
+    so that impossible dates are rejected.
+
+    PARAMETERS:
+    dtRecord - Referenced structure variable for parsed date and time.
+      - Data type: Datetime
+      - Default value: none
+      - Limited range: address space
+
+    strIso - Pointer to the datetime text.
+      - Data type: pointer to char
+      - Default value: none
+      - Limited range: address space
+
+    RETURN: Flag about valid datetime text, the structure is unchanged if false
+  */
+  static bool parseIso(Datetime &dtRecord, const char *strIso);
+
+  /*
+    Calculate checksum of data.
+
+    DESCRIPTION:
+    The method calculates CRC-8 (Dallas/Maxim) checksum with reflected
+    polynomial 0x8C and initial value 0xFF of the data, so that blank memory
+    filled with zeros or ones never matches its checksum. It protects records
+    of the library in the non-volatile memory.
+
+    PARAMETERS:
+    buffer - Pointer to the data.
+      - Data type: pointer to byte
+      - Default value: none
+      - Limited range: address space
+
+    len - Number of data bytes.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0 ~ 255
+
+    RETURN: Checksum
+  */
+  static uint8_t crc8(const uint8_t *buffer, uint8_t len);
+
+  /*
+    Convert days to civil date.
+
+    DESCRIPTION:
+    The method converts number of days since 1970-01-01 to the civil date of
+    the Gregorian calendar by days from civil date algorithm without tables
+    and loops. It is the inverse of the conversion used for epoch time.
+
+    PARAMETERS:
+    days - Number of days since 1970-01-01.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0 ~ 2^32 - 719469
+
+    year - Referenced variable for the year.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 1970 ~ 65535
+
+    month - Referenced variable for the month.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 1 ~ 12
+
+    day - Referenced variable for the day of month.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 1 ~ 31
+
+    RETURN: none
+  */
+  static void civilFromDays(uint32_t days,
+                            uint16_t &year,
+                            uint8_t &month,
+                            uint8_t &day);
+
+  /*
+    Convert internal structure to epoch seconds.
+
+    DESCRIPTION:
+    The method converts already read datetime from the chip and stored in
+    instance internal structure directly to the number of seconds since
+    1970-01-01 00:00:00 UTC (Unix time) without the Datetime structure.
+    - The method considers the chip's datetime as a local time in the time
+    zone set by the method setTimezone().
+
+    PARAMETERS: none
+
+    RETURN: Unix time in seconds
+  */
+  inline uint32_t convertEpoch() { return convertSeconds() - 60L * timezone_; }
+
+  /*
+    Read epoch seconds from the chip.
+
+    DESCRIPTION:
+    The method reads datetime from the chip in the same way as getDateTime()
+    and converts it to the number of seconds since 1970-01-01 00:00:00 UTC.
+
+    PARAMETERS:
+    epoch - Referenced variable for read Unix time.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 946684800 ~ 4102444799 (years 2000 ~ 2099)
+
+    RETURN: Result code
+  */
+  inline ResultCodes getEpoch(uint32_t &epoch)
+  {
+    if (isError(refreshRtcRecord()))
+    {
+      return getLastResult();
+    }
+    epoch = convertEpoch();
+    epoch -= getDriftCorrection(epoch);
+    return getLastResult();
+  }
+
+  /*
+    Start drift estimation.
+
+    DESCRIPTION:
+    The method sets the position of the drift record in the non-volatile
+    memory and loads recently estimated drift from it, so that the drift
+    correction survives power cycles of the microcontroller.
+    - The drift record takes DRIFT_SIZE bytes of the memory. It consists of a
+    magic byte, the start of the drift measurement interval, the drift, and
+    CRC-8 checksum of them.
+    - The method should be called after begin().
+    - If the drift record has wrong magic byte or checksum, or its interval
+    starts out of years 2000 ~ 2099, e.g., at the first usage of the memory,
+    the drift is reset. The drift is limited to PARAM_DRIFT_MAX parts per
+    billion.
+
+    PARAMETERS:
+    position - Memory position of the drift record counted from the first byte
+    of the memory.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0 ~ MEMORY_SIZE - DRIFT_SIZE
+
+    RETURN: Result code
+  */
+  ResultCodes beginDrift(uint8_t position);
+
+  /*
+    Synchronize the chip with reference time.
+
+    DESCRIPTION:
+    The method reads the chip's epoch seconds, compares them with the
+    reference time, and writes the reference time to the chip.
+    - If the drift estimation has been started and at least 1 hour has passed
+    since the recent synchronization, the method updates the drift estimation
+    in parts per billion by the measured deviation. The estimation is an
+    exponentially weighted average of measurements, so that each new
+    measurement contributes by one quarter.
+    - Each writing of time keeping registers starts new drift measurement
+    interval and stores the drift record to the non-volatile memory.
+    - The drift correction is applied by getDateTime() and getEpoch().
+
+    PARAMETERS:
+    reference - Reference Unix time, e.g., from NTP or GPS.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 946684800 ~ 4102444799 (years 2000 ~ 2099)
+
+    RETURN: Result code
+  */
+  ResultCodes syncEpoch(uint32_t reference);
+
+  /*
+    Synchronize timestamp service with the chip.
+
+    DESCRIPTION:
+    The method waits for the chip's seconds increment and anchors the epoch
+    seconds read right after it to the microcontroller's microseconds, so that
+    the timestamps are phase aligned to the chip's second boundary.
+    - If the square wave signal is attached, the method waits for its edge
+    without communication on the two-wire bus. Otherwise it polls just the
+    seconds register of the chip.
+    - The method waits at most 1.1 second, so that it should be called
+    sporadically, e.g., once per hour.
+    - The whole datetime is read right after the seconds increment, so that it
+    cannot be torn by a rollover.
+    - If the clock is halted or the seconds increment does not come in time,
+    the method fails and keeps the recent synchronization.
+
+    PARAMETERS: none
+
+    RETURN: Result code, ERROR_RCV_DATA for halted clock or timeout
+  */
+  ResultCodes syncTimestamp();
+
+  /*
+    Release the two-wire bus before sleep of the microcontroller.
+
+    DESCRIPTION:
+    The method writes pending changes of the memory mirror to the chip,
+    cancels asynchronous reading, and releases the two-wire bus, so that the
+    bus pins do not load the pull-up resistors in sleep.
+    - The bus is not released on ESP8266, which has no means for it.
+
+    PARAMETERS: none
+
+    RETURN: Result code
+  */
+  ResultCodes sleep();
+
+  /*
+    Restore the two-wire bus after sleep of the microcontroller.
+
+    DESCRIPTION:
+    The method initializes the two-wire bus and the device again without any
+    communication on the bus, so that it is much faster than the method
+    begin().
+    - The system time of the microcontroller might have stopped in sleep, so
+    that the datetime cache is invalidated and the next datetime reading
+    communicates with the chip. It is so even if the square wave signal is
+    attached, because its edges are missed in sleep modes without waking up
+    by them. The reading anchors the signal edges again.
+
+    PARAMETERS: none
+
+    RETURN: Result code
+  */
+  ResultCodes wake();
+
+  /*
+    Provide sleep period up to a wake up deadline.
+
+    DESCRIPTION:
+    The method obtains epoch seconds in the same way as the method getEpoch(),
+    i.e., from the cache or square wave signal edges if possible, and
+    calculates the number of milliseconds remaining to the deadline.
+    - The period has resolution of 1 second, so that the microcontroller wakes
+    up less than 1 second after the deadline.
+    - The period for a deadline more than about 49.7 days away is clamped to
+    the maximal one, so that the microcontroller wakes up before it.
+
+    PARAMETERS:
+    wakeEpoch - Wake up deadline in Unix time.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0 ~ 2^32 - 1
+
+    period - Referenced variable for the sleep period in milliseconds, zero
+    for passed deadline, 2^32 - 1 for too distant one.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0 ~ 2^32 - 1
+
+    RETURN: Result code
+  */
+  inline ResultCodes getSleepPeriod(uint32_t wakeEpoch, uint32_t &period)
+  {
+    uint32_t epoch = 0;
+    period = 0;
+    if (isError(getEpoch(epoch)))
+    {
+      return getLastResult();
+    }
+    if (wakeEpoch > epoch)
+    {
+      // Deadlines beyond the range of milliseconds are clamped to it
+      period = wakeEpoch - epoch > 0xFFFFFFFF / 1000
+                 ? 0xFFFFFFFF
+                 : (wakeEpoch - epoch) * 1000;
+    }
+    return getLastResult();
+  }
+
+  /*
+    Provide timestamp.
+
+    DESCRIPTION:
+    The method provides the number of microseconds since 1970-01-01 00:00:00
+    UTC composed from the epoch seconds synchronized by syncTimestamp() and
+    elapsed microseconds of the microcontroller without any communication on
+    the two-wire bus.
+    - The timestamps are monotonically non-decreasing even across
+    resynchronizations. If a resynchronization moves the time backwards, the
+    method provides the last timestamp until the time catches up.
+    - The method should be called at least once per 70 minutes because of
+    overflow of the system microseconds.
+
+    PARAMETERS: none
+
+    RETURN: Unix time in microseconds
+  */
+  uint64_t getTimestamp();
+
+  /*
+    Start asynchronous reading of datetime.
+
+    DESCRIPTION:
+    The method starts reading of time keeping registers split to steps
+    performed by subsequent calls of the method poll(), so that an application
+    loop is not blocked by the whole bus transaction at once.
+    - Each step utilizes one short bus transaction, i.e., the register pointer
+    writing or the registers receiving. The register pointer writing is
+    terminated by the STOP condition, so that other devices can be accessed
+    on the bus between steps.
+    - If this chip is accessed by a synchronous method between steps, the
+    register pointer has moved, so that the reading writes it again.
+    - If the reading verification is enabled, the received registers are
+    checked in the same way as by the synchronous reading. Seconds 59 of the
+    running clock cost one more step with reading just the seconds register,
+    inconsistent registers are received again at most PARAM_VERIFY_READS times
+    in total and then the reading fails with the error code ERROR_RCV_DATA.
+    - If the datetime can be served by the cache or square wave signal, the
+    reading completes at the first step without bus communication.
+    - After completion the datetime can be obtained by convertDateTime() or
+    convertEpoch().
+    - If a reading is already in progress, the method just lets it continue
+    with its original completion handler.
+
+    PARAMETERS:
+    onComplete - Pointer to a function called after completion of reading
+    either successful or failed. The result is provided by getLastResult().
+      - Data type: Handler
+      - Default value: nullptr
+      - Limited range: address space
+
+    RETURN: Result code
+  */
+  inline ResultCodes beginReadDateTime(Handler onComplete = nullptr)
+  {
+    // Reading in progress provides fresh datetime in either case
+    if (getAsyncBusy())
+    {
+      return setLastResult();
+    }
+    asyncHandler_ = onComplete;
+    asyncAttempts_ = Params::PARAM_VERIFY_READS;
+    asyncState_ = AsyncStates::ASYNC_POINTER;
+    return setLastResult();
+  }
+
+  /*
+    Perform next step of asynchronous reading.
+
+    DESCRIPTION:
+    The method performs at most one bus transaction of started asynchronous
+    reading and calls the completion handler after the last step. It should
+    be called in each loop iteration.
+
+    PARAMETERS: none
+
+    RETURN: Flag about completed reading, i.e., no reading in progress
+  */
+  bool poll();
+
+  /*
+    Run queued register space operations.
+
+    DESCRIPTION:
+    The method runs all operations of the batch in one bus session, in which
+    particular operations are separated by repeated START conditions and just
+    the last one is terminated by the STOP condition.
+    - The method batchDateTime() queues reading of time keeping registers to
+    the cache, so that the datetime can be obtained by convertDateTime() or
+    convertEpoch() after the batch run.
+    - The method batchConfiguration() queues writing of the cached control
+    register value, which is considered written only after successful run.
+    - The method clears the batch after running regardless of result.
+    - Writes to the non-volatile memory update the memory mirror, but reads
+    bypass it, so that the mirror should be flushed before reading.
+    - Writes to time keeping registers invalidate the datetime cache.
+
+    PARAMETERS:
+    batch - Referenced batch of operations.
+      - Data type: Batch
+      - Default value: none
+      - Limited range: address space
+
+    RETURN: Result code
+  */
+  ResultCodes runBatch(Batch &batch);
+  inline bool batchDateTime(Batch &batch)
+  {
+    return batch.read(Commands::CMD_REG_SECOND,
+                      reinterpret_cast<uint8_t *>(&rtcRecord_),
+                      sizeof(rtcRecord_));
+  }
+  inline bool batchConfiguration(Batch &batch)
+  {
+    return batch.write(Commands::CMD_REG_CONTROL, &rtcRecord_.control, 1);
+  }
+
+  /*
+    Write epoch seconds to the chip.
+
+    DESCRIPTION:
+    The method converts the number of seconds since 1970-01-01 00:00:00 UTC to
+    the local time in the time zone set by the method setTimezone() and writes
+    it to time keeping registers of the chip.
+    - The method retains the current clock halt bit and hours mode.
+    - The method sets the ISO weekday, i.e., Monday is 1 and Sunday is 7.
+
+    PARAMETERS:
+    epoch - Unix time to be written.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 946684800 ~ 4102444799 (years 2000 ~ 2099)
+
+    RETURN: Result code
+  */
+  inline ResultCodes setEpoch(uint32_t epoch)
+  {
+    encodeSeconds(epoch + 60L * timezone_);
+    dirtyTimeRegisters();
+    cacheValid_ = isSuccess(commit());
+    return getLastResult();
+  }
+
+  /*
+    Read from time keeping registers of the chip.
+
+    DESCRIPTION:
+    The method reads datetime from the chip and calls convertDateTime() method
+    for obtaining the datetime to the referenced external structure (datetime
+    record).
+    - If the caching period is set, the method reads the chip just once per
+    that period and between readings it extrapolates the datetime from the
+    recently read one by means of the microcontroller's system time without
+    any communication on the two-wire bus.
+
+    PARAMETERS:
+    dtRecord - Referenced structure variable for writing read date and time.
+      - Data type: Datetime
+      - Default value: none
+      - Limited range: address space
+
+    RETURN: Result code
+  */
+  inline ResultCodes getDateTime(Datetime &dtRecord)
+  {
+    if (isError(refreshRtcRecord()))
     {
       return getLastResult();
     }
-    setPositionInBytes();
-    if (isError(registerAddress(static_cast<uint8_t>(Addresses::ADDRESS))))
+    if (driftPpb_ == 0)
     {
-      return getLastResult();
+      convertDateTime(dtRecord);
     }
-    return readRtcRecord();
+    else
+    {
+      // Correct a copy of the cache
+      RtcRecord record = rtcRecord_;
+      advanceRtcRecord(-getDriftCorrection(convertEpoch()));
+      convertDateTime(dtRecord);
+      rtcRecord_ = record;
+    }
+    return getLastResult();
   }
 
   /*
-    Convert internal structure to datetime.
+    Read datetime from the chip as a text.
 
     DESCRIPTION:
-    The method converts already read datetime from the chip and stored in
-    instance internal structure to the referenced external structure (datetime
-    record).
-    - The method converts recently read datetime from the chip without repeating
-      the reading from it. It is useful right after begin() method, which reads
-      the chip's status in either case.
-    - The method expects 21th century, so that adds 2000 to the read two-digit
-    year number.
+    The method reads datetime from the chip in the same way as the method
+    getDateTime() and writes it to the buffer as a null terminated text in the
+    demanded format directly from BCD digits of time keeping registers without
+    any dynamic memory allocation.
+    - The datetime is always in 24 hours mode.
+    - The RFC 3339 format uses 'Z' for zero offset of the time zone.
 
     PARAMETERS:
-    dtRecord - Referenced structure variable for writing date and time.
-      - Data type: Datetime
+    buffer - Pointer to the buffer for the text of at least DATETIME_SIZE
+    characters.
+      - Data type: pointer to char
       - Default value: none
       - Limited range: address space
 
-    RETURN: none
+    format - Format of the text.
+      - Data type: DatetimeFormats
+      - Default value: DATETIME_ISO
+      - Limited range: DATETIME_ISO, DATETIME_COMPACT, DATETIME_RFC3339
+
+    RETURN: Result code
   */
-  void convertDateTime(Datetime &dtRecord);
+  ResultCodes getDateTime(
+    char *buffer,
+    DatetimeFormats format = DatetimeFormats::DATETIME_ISO);
 
   /*
-    Read from time keeping registers of the chip.
+    Read from particular time keeping registers of the chip.
 
     DESCRIPTION:
-    The method reads datetime from the chip and calls convertDateTime() method
-    for obtaining the datetime to the referenced external structure (datetime
-    record).
+    The particular method reads just the span of time keeping registers needed
+    for the requested item in order to reduce communication on the two-wire
+    bus in contrast to reading all of them.
+    - The method getSeconds() reads just the seconds register, so that it
+    updates the cached clock halt bit as well.
+    - The method getTimeOfDay() reads seconds, minutes, and hours registers
+    and updates just time items of the referenced datetime structure, so that
+    it updates cached 12 hours mode bit as well.
+    - The methods invalidate the datetime cache, so that next getDateTime()
+    reads all time keeping registers from the chip.
 
     PARAMETERS:
-    dtRecord - Referenced structure variable for writing read date and time.
+    second - Referenced variable for writing read seconds.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0 ~ 59
+
+    dtRecord - Referenced structure variable for writing read time.
       - Data type: Datetime
       - Default value: none
       - Limited range: address space
 
     RETURN: Result code
   */
-  inline ResultCodes getDateTime(Datetime &dtRecord)
+  inline ResultCodes getSeconds(uint8_t &second)
   {
-    if (isError(readRtcRecord()))
+    GBJ_DS1307_STATS_SCOPE(STATS_PARTIAL_READ);
+    uint8_t value;
+    cacheValid_ = false;
+    clockKnown_ = isSuccess(readRegisters(Commands::CMD_REG_SECOND, &value, 1));
+    if (!clockKnown_)
     {
       return getLastResult();
     }
-    convertDateTime(dtRecord);
+    mergeRtcRecord(Commands::CMD_REG_SECOND, &value, 1);
+    second = FieldSecond::decode(rtcRecord_.second);
+    return getLastResult();
+  }
+  inline ResultCodes getTimeOfDay(Datetime &dtRecord)
+  {
+    GBJ_DS1307_STATS_SCOPE(STATS_PARTIAL_READ);
+    uint8_t values[3];
+    cacheValid_ = false;
+    clockKnown_ = isSuccess(
+      readRegisters(Commands::CMD_REG_SECOND, values, sizeof(values)));
+    if (!clockKnown_)
+    {
+      return getLastResult();
+    }
+    mergeRtcRecord(Commands::CMD_REG_SECOND, values, sizeof(values));
+    convertTime(dtRecord);
+    return getLastResult();
+  }
+
+  /*
+    Read control register of the chip.
+
+    DESCRIPTION:
+    The method reads just the control register to its cache without reading
+    time keeping registers.
+    - A control register value changed by configXXX methods and not written
+    yet is kept in the cache.
+
+    PARAMETERS: none
+
+    RETURN: Result code
+  */
+  inline ResultCodes readConfiguration()
+  {
+    GBJ_DS1307_STATS_SCOPE(STATS_PARTIAL_READ);
+    uint8_t control;
+    if (isError(readRegisters(Commands::CMD_REG_CONTROL, &control, 1)))
+    {
+      return getLastResult();
+    }
+    mergeRtcRecord(Commands::CMD_REG_CONTROL, &control, 1);
     return getLastResult();
   }
 
@@ -140,7 +954,8 @@ public:
     - The method strips century from the year and writes just two-digit year
     number.
     - The method writes cached value to the control register of the chip as
-    well, so that the chip can be set, started and configured at once.
+    well if it has been changed by some of configXXX methods, so that the chip
+    can be set, started and configured at once.
 
     PARAMETERS:
     dtRecord - Referenced structure variable for desired date and time.
@@ -163,6 +978,8 @@ public:
     - The method sets datetime regardless the RTC chip is running or not.
     - If no input parameters are used, just the CH bit is reset with retaining
     current second.
+    - The method with datetime encoded at compile time does not parse strings
+    at runtime at all.
 
     PARAMETERS:
     strDate - Pointer to a system date formatted string.
@@ -175,6 +992,12 @@ public:
       - Default value: none
       - Limited range: address range
 
+    bcdDateTime - Referenced structure variable with datetime encoded at
+    compile time.
+      - Data type: BcdDatetime
+      - Default value: none
+      - Limited range: address space
+
     weekday - Number of current day in a week. It is up to an application to set
     the starting day in the week. If weekdays are irrelevant, the default value
     may be used. The provided weekday fallbacks to valid range.
@@ -213,18 +1036,10 @@ public:
     gbj_apphelpers::parseDateTime(rtcDateTime, strDate, strTime);
     return setDateTime(rtcDateTime);
   }
-  inline ResultCodes startClock()
-  {
-    bool origBusStop = getBusStop();
-    setBusRepeat();
-    if (isError(readRtcRecord()))
-    {
-      return getLastResult();
-    }
-    configClockEnable();
-    setBusStopFlag(origBusStop);
-    return busSend(Commands::CMD_REG_SECOND, rtcRecord_.second);
-  }
+  ResultCodes startClock(const BcdDatetime &bcdDateTime,
+                         uint8_t weekday = 1,
+                         bool mode12h = false);
+  inline ResultCodes startClock() { return switchClock(true); }
 
   /*
     Stop clock.
@@ -237,18 +1052,7 @@ public:
 
     RETURN: Result code
   */
-  inline ResultCodes stopClock()
-  {
-    bool origBusStop = getBusStop();
-    setBusRepeat();
-    if (isError(readRtcRecord()))
-    {
-      return getLastResult();
-    }
-    configClockDisable();
-    setBusStopFlag(origBusStop);
-    return busSend(Commands::CMD_REG_SECOND, rtcRecord_.second);
-  }
+  inline ResultCodes stopClock() { return switchClock(false); }
 
   /*
     Start generating square wave signal.
@@ -298,49 +1102,448 @@ public:
     return getLastResult();
   }
 
+  /*
+    Keep time by square wave signal.
+
+    DESCRIPTION:
+    The method starts generating square wave signal of frequency 1 Hz and
+    attaches an interrupt to the microcontroller's pin connected to the SQW/OUT
+    pin of the chip. Each falling edge of the signal, when the chip increments
+    its seconds, moves the cached datetime forward by one second, so that
+    getDateTime() does not communicate on the two-wire bus at all.
+    - The method waits for the first falling edge, but at most 1.1 second, and
+    reads time keeping registers right after it in order to have the whole
+    second for reading the chip before next edge.
+    - The SQW/OUT pin of the chip is an open drain output, so that the method
+    activates internal pull-up resistor of the microcontroller's pin.
+    - Reading datetime should happen at least once per 18 hours for keeping
+    the counter of edges consistent.
+    - The frequency of the square wave signal should not be changed until the
+    detaching by detachSqw().
+    - Just one device can keep time by the square wave signal, because the
+    interrupt handler is shared by all instances. If another device has
+    attached it, the method fails with the error code ERROR_PINS.
+
+    PARAMETERS:
+    pin - Number of the microcontroller's pin with external interrupt.
+      - Data type: positive integer
+      - Default value: none
+      - Limited range: pins with external interrupt
+
+    RETURN: Result code
+  */
+  ResultCodes attachSqw(uint8_t pin);
+
+  /*
+    Stop keeping time by square wave signal.
+
+    DESCRIPTION:
+    The method detaches the interrupt from the pin connected to the SQW/OUT
+    pin of the chip. The square wave signal generating is not stopped.
+    - The interrupt handler is released for another device only by the device,
+    which has attached it.
+
+    PARAMETERS: none
+
+    RETURN: none
+  */
+  void detachSqw();
+
+  /*
+    Write data to non-volatile memory.
+
+    DESCRIPTION:
+    The particular method writes data to the non-volatile memory of the chip.
+    - The method store() is a template for any data type and shadows the
+    template of the parent library, so that it utilizes the memory mirror.
+    - If the memory mirror is set, the method just updates it and marks
+    written bytes as changed. All changed bytes are written to the chip at once
+    by flushNvram() or automatically at writing after expired flush deadline.
+    - The memory is written in as long bursts as two-wire bus buffer allows.
+
+    PARAMETERS:
+    position - Memory position counted from the first byte of the memory.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0 ~ MEMORY_SIZE - 1
+
+    data - Value of any data type to be written.
+      - Data type: any
+      - Default value: none
+      - Limited range: MEMORY_SIZE bytes
+
+    buffer - Pointer to the byte buffer with data to be written.
+      - Data type: pointer to byte
+      - Default value: none
+      - Limited range: address space
+
+    len - Number of bytes to be written.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0 ~ MEMORY_SIZE
+
+    RETURN: Result code
+  */
+  template<class T>
+  inline ResultCodes store(uint32_t position, T data)
+  {
+    return storeNvram(
+      position, reinterpret_cast<const uint8_t *>(&data), sizeof(T));
+  }
+  ResultCodes storeNvram(uint32_t position, const uint8_t *buffer, uint8_t len);
+
+  /*
+    Read data from non-volatile memory.
+
+    DESCRIPTION:
+    The particular method reads data from the non-volatile memory of the chip.
+    - The method retrieve() is a template for any data type and shadows the
+    template of the parent library, so that it utilizes the memory mirror.
+    - If the memory mirror is set, the method reads from it without any
+    communication on the two-wire bus.
+
+    PARAMETERS:
+    position - Memory position counted from the first byte of the memory.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0 ~ MEMORY_SIZE - 1
+
+    data - Referenced variable of any data type for read value.
+      - Data type: any
+      - Default value: none
+      - Limited range: MEMORY_SIZE bytes
+
+    buffer - Pointer to the byte buffer for read data.
+      - Data type: pointer to byte
+      - Default value: none
+      - Limited range: address space
+
+    len - Number of bytes to be read.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0 ~ MEMORY_SIZE
+
+    RETURN: Result code
+  */
+  template<class T>
+  inline ResultCodes retrieve(uint32_t position, T &data)
+  {
+    return retrieveNvram(
+      position, reinterpret_cast<uint8_t *>(&data), sizeof(T));
+  }
+  ResultCodes retrieveNvram(uint32_t position, uint8_t *buffer, uint8_t len);
+
+  /*
+    Write changed bytes of memory mirror to the chip.
+
+    DESCRIPTION:
+    The method writes the span of memory mirror from the first to the last
+    changed byte to the non-volatile memory of the chip, so that multiple
+    small writes are combined to one or a few bus transactions.
+
+    PARAMETERS:
+    force - Flag about writing regardless of the flush deadline. Otherwise the
+    method writes only if the deadline has expired, so that it can be called
+    in each loop iteration.
+      - Data type: boolean
+      - Default value: true
+      - Limited range: true, false
+
+    RETURN: Result code
+  */
+  ResultCodes flushNvram(bool force = true);
+
+  /*
+    Take image of the chip.
+
+    DESCRIPTION:
+    The method reads all time keeping registers, control register, and
+    non-volatile memory of the chip at once in the fewest bursts allowed by
+    the two-wire bus buffer and writes them to the image with a header of
+    magic bytes and format version.
+    - The method flushes the memory mirror before reading and updates the
+    datetime cache from the image.
+
+    PARAMETERS:
+    image - Pointer to the buffer for the image of IMAGE_SIZE bytes.
+      - Data type: pointer to byte
+      - Default value: none
+      - Limited range: address space
+
+    RETURN: Result code
+  */
+  ResultCodes snapshot(uint8_t *image);
+
+  /*
+    Write image to the chip.
+
+    DESCRIPTION:
+    The method writes the image taken by the method snapshot() back to the
+    chip at once in the fewest bursts allowed by the two-wire bus buffer.
+    - If the clock is not restored, the time keeping registers are skipped and
+    just the control register and non-volatile memory are written.
+    - The method updates the datetime cache and memory mirror from the image.
+    - If the drift estimation has been started and the clock is restored, the
+    drift measurement interval starts anew as at setting datetime.
+
+    PARAMETERS:
+    image - Pointer to the image of IMAGE_SIZE bytes.
+      - Data type: pointer to byte
+      - Default value: none
+      - Limited range: address space
+
+    clock - Flag about restoring time keeping registers.
+      - Data type: boolean
+      - Default value: true
+      - Limited range: true, false
+
+    RETURN: Result code, ERROR_POSITION for image with wrong header
+  */
+  ResultCodes restore(const uint8_t *image, bool clock = true);
+
   // Setters
 
+  /*
+    Set memory mirror.
+
+    DESCRIPTION:
+    The method sets the buffer for mirroring the whole non-volatile memory of
+    the chip in order to serve reading from it without communication on the
+    two-wire bus and to combine writing to it.
+    - The method should be called before the method begin(), which loads the
+    mirror.
+
+    PARAMETERS:
+    mirror - Pointer to the buffer of MEMORY_SIZE bytes. Null pointer disables
+    mirroring.
+      - Data type: pointer to byte
+      - Default value: none
+      - Limited range: address space
+
+    RETURN: none
+  */
+  inline void setNvramMirror(uint8_t *mirror) { nvramMirror_ = mirror; }
+
+  /*
+    Set flush deadline of memory mirror.
+
+    DESCRIPTION:
+    The method sets the time period from the first change of the memory
+    mirror, after which changed bytes are written to the chip at next writing
+    to the memory or at calling flushNvram(false).
+
+    PARAMETERS:
+    deadline - Time period in milliseconds. Zero value disables automatic
+    writing, so that just flushNvram() writes the memory.
+      - Data type: non-negative integer
+      - Default value: 0
+      - Limited range: 0 ~ 2^32 - 1
+
+    RETURN: none
+  */
+  inline void setNvramDeadline(uint32_t deadline = 0)
+  {
+    nvramDeadline_ = deadline;
+  }
+
   /*
     Write control register value to the device.
 
     DESCRIPTION:
-    The method sends prepared control register value to the device's control
-    register.
+    The method sends prepared control register value to the device's control
+    register only if it has been changed by some of configXXX methods in order
+    to avoid useless communication on the two-wire bus.
+
+    PARAMETERS: none
+
+    RETURN: Result code
+  */
+  inline ResultCodes setConfiguration()
+  {
+    if (!(rtcDirty_ & (1 << Commands::CMD_REG_CONTROL)))
+    {
+      return setLastResult();
+    }
+    GBJ_DS1307_STATS_SCOPE(STATS_REGISTERS_WRITE);
+    if (isError(
+          writeRegisters(Commands::CMD_REG_CONTROL, &rtcRecord_.control, 1)))
+    {
+      return getLastResult();
+    }
+    rtcDirty_ &= ~(1 << Commands::CMD_REG_CONTROL);
+    return getLastResult();
+  }
+
+  /*
+    Write changed registers to the device.
+
+    DESCRIPTION:
+    The method sends all registers changed by configXXX methods to the device
+    at once in one transaction, which starts at the first changed register and
+    ends at the last one.
+    - Changing just the hours or just the square wave rate costs a couple of
+    bytes in contrast to the writing the whole time keeping record.
+    - Changed registers survive datetime readings until the commit, which
+    update just unchanged registers of the cache. If just the clock halt bit
+    has been changed, the seconds of the cache follow the chip, so that the
+    commit right after reading does not move the clock back.
+
+    PARAMETERS: none
+
+    RETURN: Result code
+  */
+  ResultCodes commit();
+
+  /*
+    Set caching period of datetime.
+
+    DESCRIPTION:
+    The method sets the time period, during which the datetime is not read from
+    the chip, but it is extrapolated from recently read one by the system time
+    of the microcontroller.
+    - The extrapolated datetime has resolution of 1 second and can lag behind
+    the chip's one less than 1 second, because the phase of the chip's second
+    at reading is unknown.
+    - The period should be chosen with respect to the accuracy of the
+    microcontroller's clock, e.g., a ceramic resonator with tolerance 0.5% lags
+    or leads 300 ms in a 1 minute period.
+
+    PARAMETERS:
+    period - Caching period in milliseconds. Zero value disables caching, so
+    that each datetime reading communicates with the chip.
+      - Data type: non-negative integer
+      - Default value: 0
+      - Limited range: 0 ~ 2^32 - 1
+
+    RETURN: none
+  */
+  inline void setCachePeriod(uint32_t period = 0) { cachePeriod_ = period; }
+
+  /*
+    Set time zone of the chip's datetime.
+
+    DESCRIPTION:
+    The method sets the offset of the local time kept by the chip from UTC
+    for conversions to and from epoch seconds.
+
+    PARAMETERS:
+    offset - Offset from UTC in minutes, e.g., 60 for CET.
+      - Data type: integer
+      - Default value: 0
+      - Limited range: -720 ~ 840
+
+    RETURN: none
+  */
+  inline void setTimezone(int16_t offset = 0) { timezone_ = offset; }
+
+  /*
+    Set verification of datetime reading.
+
+    DESCRIPTION:
+    The method enables or disables checking of each datetime reading from the
+    chip for consistency.
+    - The reading is repeated if some time keeping register contains invalid
+    BCD digits or a value out of range of its datetime field.
+    - If seconds read as 59, just the seconds register is read once more,
+    because the carry to minutes might have happened during reading. If it has
+    changed, the reading is repeated. Seconds read as 00 need no check, because
+    the registers are read in ascending order from seconds, so that other
+    fields are read after the carry.
+    - The reading is repeated at most PARAM_VERIFY_READS times in total, then
+    the reading fails with the error code ERROR_RCV_DATA and the datetime
+    cache stays invalid.
+    - The verification costs the repeated reading of seconds on average once
+    per a minute only.
+
+    PARAMETERS:
+    verify - Flag about verifying.
+      - Data type: boolean
+      - Default value: none
+      - Limited range: true, false
+
+    RETURN: none
+  */
+  inline void setVerifyRead(bool verify) { verifyRead_ = verify; }
+
+  /*
+    Set tuning of the bus clock.
+
+    DESCRIPTION:
+    The method enables or disables calibration of the two-wire bus clock
+    frequency in the method begin().
+    - The calibration reads the whole non-volatile memory at 100 kHz as a
+    reference and then several times at 400 kHz. If all readings at the higher
+    frequency succeed and match the reference, that frequency is kept,
+    otherwise the bus falls back to 100 kHz. The content of the memory is not
+    changed.
+    - If the bus has been tuned to 400 kHz, it falls back to 100 kHz after
+    PARAM_TUNE_ERRORS consecutive failed readings or writings at runtime.
+
+    PARAMETERS:
+    tuning - Flag about tuning.
+      - Data type: boolean
+      - Default value: none
+      - Limited range: true, false
+
+    RETURN: none
+  */
+  inline void setBusTuning(bool tuning) { busTuning_ = tuning; }
+
+  /*
+    Update time keeping registers values.
+
+    DESCRIPTION:
+    The method sanitizes datetime taken from referenced external structure and
+    updates time keeping registers cache, which it marks as changed only if
+    they differ from cached values. The changed registers are written to the
+    chip by the method commit().
+    - The method compares the datetime with the cached one, so that the cache
+    should be current, e.g., by getDateTime() called right before. If the
+    datetime cache is not valid, all time keeping registers are marked as
+    changed.
+    - The method retains the clock halt bit.
 
-    PARAMETERS: none
+    PARAMETERS:
+    dtRecord - Referenced structure variable for desired date and time.
+      - Data type: Datetime
+      - Default value: none
+      - Limited range: address space
 
-    RETURN: Result code
+    RETURN: none
   */
-  inline ResultCodes setConfiguration()
-  {
-    return busSend(Commands::CMD_REG_CONTROL, rtcRecord_.control);
-  }
+  void configDateTime(const Datetime &dtRecord);
 
   // Preparation of timekeeping registers
   inline void configClockEnable()
   {
-    rtcRecord_.second &= ~(1 << SecondBits::CONFIG_CH);
+    updateRtcRecord(Commands::CMD_REG_SECOND,
+                    rtcRecord_.second & ~(1 << SecondBits::CONFIG_CH));
   }
   inline void configClockDisable()
   {
-    rtcRecord_.second |= (1 << SecondBits::CONFIG_CH);
+    updateRtcRecord(Commands::CMD_REG_SECOND,
+                    rtcRecord_.second | (1 << SecondBits::CONFIG_CH));
   }
   // Preparation of control register value
   inline void configSqwLevelHigh()
   {
-    rtcRecord_.control |= (1 << ConfigBits::CONFIG_OUT);
+    updateRtcRecord(Commands::CMD_REG_CONTROL,
+                    rtcRecord_.control | (1 << ConfigBits::CONFIG_OUT));
   }
   inline void configSqwLevelLow()
   {
-    rtcRecord_.control &= ~(1 << ConfigBits::CONFIG_OUT);
+    updateRtcRecord(Commands::CMD_REG_CONTROL,
+                    rtcRecord_.control & ~(1 << ConfigBits::CONFIG_OUT));
   }
   inline void configSqwEnable()
   {
-    rtcRecord_.control |= (1 << ConfigBits::CONFIG_SQWE);
+    updateRtcRecord(Commands::CMD_REG_CONTROL,
+                    rtcRecord_.control | (1 << ConfigBits::CONFIG_SQWE));
   }
   inline void configSqwDisable()
   {
-    rtcRecord_.control &= ~(1 << ConfigBits::CONFIG_SQWE);
+    updateRtcRecord(Commands::CMD_REG_CONTROL,
+                    rtcRecord_.control & ~(1 << ConfigBits::CONFIG_SQWE));
   }
 
   /*
@@ -362,13 +1565,36 @@ public:
   inline void configSqwRate(SquareWaveFrequency rate)
   {
     // Clear bits
-    rtcRecord_.control &= ~(B11 << ConfigBits::CONFIG_RS0);
+    uint8_t control = rtcRecord_.control & ~(B11 << ConfigBits::CONFIG_RS0);
     // Set bits
-    rtcRecord_.control |= ((rate & B11) << ConfigBits::CONFIG_RS0);
+    control |= ((rate & B11) << ConfigBits::CONFIG_RS0);
+    updateRtcRecord(Commands::CMD_REG_CONTROL, control);
   }
 
   // Getters
+  inline uint32_t getCachePeriod() { return cachePeriod_; }
+  inline int16_t getTimezone() { return timezone_; }
+  inline bool getVerifyRead() { return verifyRead_; }
+  inline bool getBusTuning() { return busTuning_; }
+  inline bool getBusTuned() { return busTuned_; }
+  inline int32_t getDrift() { return driftPpb_; }
+  inline bool getAsyncBusy()
+  {
+    return asyncState_ != AsyncStates::ASYNC_IDLE;
+  }
+  inline uint32_t getNvramDeadline() { return nvramDeadline_; }
+  inline bool getNvramDirty() { return nvramDirtyFirst_ <= nvramDirtyLast_; }
+  inline bool getSqwAttached() { return sqwPin_ != Params::PARAM_NOPIN; }
   inline uint8_t getConfiguration() { return rtcRecord_.control; }
+  inline BootState getBootState()
+  {
+    return { rtcRecord_.control,
+             static_cast<uint8_t>(rtcRecord_.second &
+                                  (1 << SecondBits::CONFIG_CH)),
+             static_cast<uint8_t>(rtcRecord_.hour &
+                                  (1 << HourBits::CONFIG_12H)),
+             busTuned_ };
+  }
   inline SquareWaveFrequency getSqwRate()
   {
     return static_cast<SquareWaveFrequency>(
@@ -395,6 +1621,37 @@ public:
     return ((rtcRecord_.hour >> HourBits::CONFIG_12H) & B1) == 1;
   }
 
+#ifdef GBJ_DS1307_STATS
+  /*
+    Provide statistics of an operation.
+
+    DESCRIPTION:
+    The method copies the statistics of the operation collected since the
+    start or recent reset to the referenced external structure.
+    - The statistics are available only if the macro GBJ_DS1307_STATS is
+    defined for the whole build, e.g., by a build flag, otherwise they are
+    removed from the code entirely.
+
+    PARAMETERS:
+    operation - Operation of interest.
+      - Data type: StatsOperations
+      - Default value: none
+      - Limited range: STATS_DATETIME_READ ~ STATS_BATCH
+
+    stats - Referenced structure variable for the statistics.
+      - Data type: Stats
+      - Default value: none
+      - Limited range: address space
+
+    RETURN: none
+  */
+  inline void getStats(StatsOperations operation, Stats &stats)
+  {
+    stats = stats_[operation];
+  }
+  inline void resetStats() { memset(stats_, 0, sizeof(stats_)); }
+#endif
+
 private:
   enum Commands : uint8_t
   {
@@ -442,6 +1699,32 @@ private:
   {
     // Control register byte after power-up reset
     PARAM_POWERUP = 0x03,
+    // No pin for square wave signal
+    PARAM_NOPIN = 0xFF,
+    // Maximal number of data bytes in one bus transaction, a written one
+    // shares the buffer with the register address, none exceeds the register
+    // space of the chip
+    PARAM_BURST_READ = GBJ_DS1307_WIRE_BUFFER < 0x40 ? GBJ_DS1307_WIRE_BUFFER
+                                                     : 0x40,
+    PARAM_BURST_WRITE = GBJ_DS1307_WIRE_BUFFER - 1 < 0x40
+                          ? GBJ_DS1307_WIRE_BUFFER - 1
+                          : 0x40,
+    // Minimal drift measurement interval in seconds
+    PARAM_DRIFT_PERIOD = 3600,
+    // Maximal absolute drift in parts per billion, i.e., 500 ppm
+    PARAM_DRIFT_MAX = 500000L,
+    // First byte of drift record
+    PARAM_DRIFT_MAGIC = 0xD7,
+    // Header of snapshot image
+    PARAM_IMAGE_MAGIC1 = 0x13,
+    PARAM_IMAGE_MAGIC2 = 0x07,
+    PARAM_IMAGE_VERSION = 1,
+    // Maximal number of verified datetime readings
+    PARAM_VERIFY_READS = 3,
+    // Number of verified memory readings at bus clock tuning
+    PARAM_TUNE_READS = 3,
+    // Number of consecutive bus errors for bus clock fallback
+    PARAM_TUNE_ERRORS = 3,
   };
   struct RtcRecord
   {
@@ -454,27 +1737,528 @@ private:
     uint8_t year;
     uint8_t control;
   } rtcRecord_;
-  inline ResultCodes readRtcRecord()
+  // Bits of changed registers in the cache
+  uint8_t rtcDirty_ = 0;
+  // Changed bits of the seconds register, just clock halt bit by configXXX
+  uint8_t rtcDirtySecond_ = 0;
+  // Mirror of non-volatile memory
+  uint8_t *nvramMirror_ = nullptr;
+  uint8_t nvramDirtyFirst_ = Memory::MEMORY_SIZE;
+  uint8_t nvramDirtyLast_ = 0;
+  uint32_t nvramDeadline_ = 0;
+  uint32_t nvramTimestamp_;
+  // Offset of local time from UTC in minutes
+  int16_t timezone_ = 0;
+  // Asynchronous reading
+  enum AsyncStates : uint8_t
+  {
+    ASYNC_IDLE,
+    ASYNC_POINTER,
+    ASYNC_RECEIVE,
+    // Repeated reading of seconds 59 for detecting a carry
+    ASYNC_VERIFY,
+  };
+  AsyncStates asyncState_ = AsyncStates::ASYNC_IDLE;
+  Handler asyncHandler_ = nullptr;
+  // Received registers waiting for verification
+  RtcRecord asyncRecord_;
+  uint8_t asyncAttempts_;
+  // Drift estimation
+  uint8_t driftPosition_ = Memory::MEMORY_SIZE;
+  uint32_t driftEpoch_ = 0;
+  int32_t driftPpb_ = 0;
+  // Seconds of drift since recent synchronization
+  inline int32_t getDriftCorrection(uint32_t epoch)
+  {
+    if (driftPpb_ == 0 || epoch < driftEpoch_)
+    {
+      return 0;
+    }
+    return static_cast<int64_t>(epoch - driftEpoch_) * driftPpb_ / 1000000000L;
+  }
+  ResultCodes storeDrift();
+  // Timestamp service
+  uint32_t stampEpoch_ = 0;
+  uint32_t stampMicros_ = 0;
+  uint64_t stampLast_ = 0;
+  // Caching of datetime
+  uint32_t cachePeriod_ = 0;
+  // Anchor of extrapolation moved by whole seconds
+  uint32_t cacheTimestamp_;
+  // Recent reading or writing of time keeping registers for cache expiration
+  uint32_t cacheSynced_;
+  bool cacheValid_ = false;
+  // Cached seconds register with clock halt bit matches the chip
+  bool clockKnown_ = false;
+  bool verifyRead_ = false;
+  // Tuning of bus clock
+  bool busTuning_ = false;
+  bool busTuned_ = false;
+  uint8_t busErrors_ = 0;
+#ifdef GBJ_DS1307_STATS
+  Stats stats_[StatsOperations::STATS_OPERATIONS] = {};
+  StatsOperations statsOperation_ = StatsOperations::STATS_DATETIME_READ;
+  // Collector of statistics of an operation for its lifetime
+  class StatsScope
+  {
+  public:
+    StatsScope(gbj_ds1307 *device, StatsOperations operation)
+      : device_(device)
+    {
+      origOperation_ = device_->statsOperation_;
+      device_->statsOperation_ = operation;
+      timestamp_ = micros();
+    }
+    ~StatsScope()
+    {
+      uint32_t latency = micros() - timestamp_;
+      Stats &stats = device_->stats_[device_->statsOperation_];
+      if (stats.calls++ == 0 || latency < stats.latencyMin)
+      {
+        stats.latencyMin = latency;
+      }
+      if (latency > stats.latencyMax)
+      {
+        stats.latencyMax = latency;
+      }
+      stats.latencySum += latency;
+      ResultCodes result = device_->getLastResult();
+      if (device_->isError(result))
+      {
+        stats.errors[statsError(result)]++;
+      }
+      device_->statsOperation_ = origOperation_;
+    }
+
+  private:
+    gbj_ds1307 *device_;
+    uint32_t timestamp_;
+    StatsOperations origOperation_;
+  };
+  static StatsErrors statsError(ResultCodes result)
+  {
+    switch (result)
+    {
+      case ResultCodes::ERROR_NACK_DATA:
+        return StatsErrors::STATS_ERROR_NACK_DATA;
+      case ResultCodes::ERROR_ADDR:
+        return StatsErrors::STATS_ERROR_ADDR;
+      case ResultCodes::ERROR_PINS:
+        return StatsErrors::STATS_ERROR_PINS;
+      case ResultCodes::ERROR_RCV_DATA:
+        return StatsErrors::STATS_ERROR_RCV_DATA;
+      case ResultCodes::ERROR_POSITION:
+        return StatsErrors::STATS_ERROR_POSITION;
+      default:
+        return StatsErrors::STATS_ERROR_OTHER;
+    }
+  }
+  inline void statsBytes(uint8_t in, uint8_t out)
+  {
+    stats_[statsOperation_].bytesIn += in;
+    stats_[statsOperation_].bytesOut += out;
+  }
+#endif
+  // Timekeeping by square wave signal
+  static gbj_ds1307 *sqwDevice_;
+  volatile uint16_t sqwTicks_ = 0;
+  uint16_t sqwTicksRead_ = 0;
+  uint8_t sqwPin_ = Params::PARAM_NOPIN;
+
+  static void isrSqw();
+  inline uint16_t getSqwTicks()
+  {
+    // Lock-free reading of the counter updated by an interrupt
+    uint16_t ticks;
+    do
+    {
+      ticks = sqwTicks_;
+    } while (ticks != sqwTicks_);
+    return ticks;
+  }
+  // Anchor the cache to time keeping registers just read or written
+  inline void anchorCache()
+  {
+    cacheTimestamp_ = cacheSynced_ = millis();
+    sqwTicksRead_ = getSqwTicks();
+  }
+
+  /*
+    Read or write span of registers.
+
+    DESCRIPTION:
+    The particular method reads or writes consecutive registers of the chip
+    in bursts limited by the two-wire bus buffer size.
+
+    PARAMETERS:
+    reg - Address of the first register.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0x00 ~ 0x3F
+
+    buffer - Pointer to the byte buffer for registers values.
+      - Data type: pointer to byte
+      - Default value: none
+      - Limited range: address space
+
+    len - Number of registers.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0 ~ 64
+
+    RETURN: Result code
+  */
+  ResultCodes readRegisters(uint8_t reg, uint8_t *buffer, uint8_t len);
+  ResultCodes writeRegisters(uint8_t reg, const uint8_t *buffer, uint8_t len);
+  // Asynchronous receiving after the register pointer moved writes it again
+  inline void movePointer()
+  {
+    if (asyncState_ == AsyncStates::ASYNC_RECEIVE)
+    {
+      asyncState_ = AsyncStates::ASYNC_POINTER;
+    }
+  }
+  // Caching of asynchronously received registers, if valid, otherwise flag
+  // about repeated receiving
+  bool acceptAsyncRecord(bool valid);
+
+  // Initialization of the two-wire bus and the device address
+  inline ResultCodes beginBus()
   {
-    bool origBusStop = getBusStop();
-    setBusRepeat();
-    if (isError(busSend(CMD_REG_SECOND)))
+    if (isError(gbj_memory::begin(Commands::CMD_REG_RAM_MAX,
+                                  Commands::CMD_REG_RAM_MAX -
+                                    Commands::CMD_REG_RAM_MIN + 1,
+                                  Commands::CMD_REG_RAM_MIN)))
     {
       return getLastResult();
     }
-    setBusStopFlag(origBusStop);
-    return busReceive(reinterpret_cast<uint8_t *>(&rtcRecord_),
-                      sizeof(rtcRecord_));
+    setPositionInBytes();
+    return registerAddress(static_cast<uint8_t>(Addresses::ADDRESS));
+  }
+  inline ResultCodes loadNvramMirror()
+  {
+    if (nvramMirror_ == nullptr)
+    {
+      return setLastResult();
+    }
+    if (isError(readRegisters(
+          Commands::CMD_REG_RAM_MIN, nvramMirror_, Memory::MEMORY_SIZE)))
+    {
+      return getLastResult();
+    }
+    nvramDirtyFirst_ = Memory::MEMORY_SIZE;
+    return getLastResult();
+  }
+
+  /*
+    Calibrate bus clock.
+
+    DESCRIPTION:
+    The method sets the highest bus clock frequency, at which repeated
+    readings of non-volatile memory match the reference one at 100 kHz.
+
+    PARAMETERS: none
+
+    RETURN: Result code
+  */
+  ResultCodes tuneBusClock();
+  // Fallback of tuned bus clock after consecutive errors
+  inline ResultCodes trackBusClock(ResultCodes result)
+  {
+    if (!busTuned_)
+    {
+      return result;
+    }
+    if (isSuccess(result))
+    {
+      busErrors_ = 0;
+    }
+    else if (++busErrors_ >= Params::PARAM_TUNE_ERRORS)
+    {
+      setBusClock(ClockSpeeds::CLOCK_100KHZ);
+      busTuned_ = false;
+    }
+    return result;
+  }
+  inline void updateRtcRecord(Commands reg, uint8_t value)
+  {
+    uint8_t *item = reinterpret_cast<uint8_t *>(&rtcRecord_) + reg;
+    if (*item != value)
+    {
+      if (reg == Commands::CMD_REG_SECOND)
+      {
+        rtcDirtySecond_ |= *item ^ value;
+      }
+      *item = value;
+      rtcDirty_ |= 1 << reg;
+    }
+  }
+  // All time keeping registers to be written
+  inline void dirtyTimeRegisters()
+  {
+    rtcDirty_ |= (1 << Commands::CMD_REG_CONTROL) - 1;
+    rtcDirtySecond_ = 0xFF;
+  }
+
+  /*
+    Update time keeping registers cache by read registers.
+
+    DESCRIPTION:
+    The method copies the registers read from the chip to the cache except
+    those changed by configXXX methods and not written yet, so that a reading
+    between a change and its commit does not discard the change.
+    - From the changed seconds register just the changed bits are kept, so that
+    a pending clock halt bit does not freeze the seconds.
+
+    PARAMETERS:
+    reg - Address of the first read register.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0x00 ~ 0x07
+
+    buffer - Pointer to the byte buffer with read registers values.
+      - Data type: pointer to byte
+      - Default value: none
+      - Limited range: address space
+
+    len - Number of read registers.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 1 ~ 8
+
+    RETURN: none
+  */
+  void mergeRtcRecord(uint8_t reg, const uint8_t *buffer, uint8_t len);
+
+  /*
+    Read time keeping registers cache.
+
+    DESCRIPTION:
+    The method reads all time keeping registers and control register from the
+    chip at once and anchors the cache. If the reading verification is enabled,
+    the method checks the read registers for consistency.
+
+    PARAMETERS: none
+
+    RETURN: Result code
+  */
+  ResultCodes readRtcRecord();
+
+  // Update caches by a successful write of a batch
+  void syncBatchWrite(const Batch::Item &item);
+
+  /*
+    Validate read time keeping registers.
+
+    DESCRIPTION:
+    The method checks whether all time keeping registers contain valid BCD
+    digits within ranges of corresponding datetime fields and no unused bits.
+
+    PARAMETERS:
+    record - Referenced structure with read registers.
+      - Data type: RtcRecord
+      - Default value: none
+      - Limited range: address space
+
+    RETURN: Flag about valid registers
+  */
+  bool checkRtcRecord(const RtcRecord &record);
+
+  /*
+    Update time keeping registers cache.
+
+    DESCRIPTION:
+    The method either moves the time keeping registers forward by counted
+    edges of square wave signal, or reads them from the chip, or extrapolates
+    them within the caching period from the recently read ones.
+
+    PARAMETERS: none
+
+    RETURN: Result code
+  */
+  ResultCodes refreshRtcRecord();
+
+  /*
+    Move time keeping registers cache.
+
+    DESCRIPTION:
+    The method adds the provided number of seconds to the datetime stored in
+    time keeping registers cache with respect to rollover of all datetime
+    items, leap years, and 12 hours mode.
+    - The weekday is moved by the number of passed days, so that the weekdays
+    sequence of an application is retained.
+
+    PARAMETERS:
+    seconds - Number of seconds to be added, negative for moving backwards.
+      - Data type: integer
+      - Default value: none
+      - Limited range: -2^31 ~ 2^31 - 1
+
+    RETURN: none
+  */
+  void advanceRtcRecord(int32_t seconds);
+
+  /*
+    Convert time keeping registers cache to seconds and back.
+
+    DESCRIPTION:
+    The particular method converts BCD values of time keeping registers cache
+    directly to the number of seconds since 1970-01-01 00:00:00 of the same
+    time zone or vice versa by days from civil date algorithm without tables
+    and loops.
+    - The method encodeSeconds() retains clock halt bit and hours mode and
+    sets ISO weekday.
+
+    PARAMETERS:
+    timestamp - Number of seconds since 1970-01-01 00:00:00.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: years 2000 ~ 2099
+
+    RETURN: Number of seconds or none
+  */
+  uint32_t convertSeconds();
+  void encodeSeconds(uint32_t timestamp);
+  static uint32_t daysFromCivil(uint16_t year, uint8_t month, uint8_t day);
+
+  /*
+    Update time keeping registers cache by datetime.
+
+    DESCRIPTION:
+    The method sanitizes datetime from the referenced external structure and
+    stores it to the time keeping registers cache with retaining clock halt
+    bit.
+
+    PARAMETERS:
+    dtRecord - Referenced structure variable with date and time.
+      - Data type: Datetime
+      - Default value: none
+      - Limited range: address space
+
+    RETURN: none
+  */
+  void encodeDateTime(const Datetime &dtRecord);
+
+  /*
+    Update clock halt bit in the chip.
+
+    DESCRIPTION:
+    The method reads just the seconds register and writes it back with
+    updated clock halt bit only if it differs from desired one.
+    - The seconds of the halted clock do not change. So that if the seconds
+    register has been read or written recently and claims the halted clock,
+    the method does not read the chip at all and relies on the cached one,
+    even if the datetime cache has been invalidated meanwhile. The chip never
+    resets the clock halt bit on its own, so that the cached register is stale
+    only if the chip is written by another bus master.
+    - If the seconds register is read, the datetime cache is invalidated,
+    because its other registers are older than the read seconds.
+
+    PARAMETERS:
+    enable - Flag about desired running of the clock.
+      - Data type: boolean
+      - Default value: none
+      - Limited range: true, false
+
+    RETURN: Result code
+  */
+  ResultCodes switchClock(bool enable);
+
+  /*
+    Convert time items of internal structure to datetime.
+
+    DESCRIPTION:
+    The method converts seconds, minutes, and hours from time keeping
+    registers cache to the referenced external structure and leaves its date
+    items untouched.
+
+    PARAMETERS:
+    dtRecord - Referenced structure variable for writing time.
+      - Data type: Datetime
+      - Default value: none
+      - Limited range: address space
+
+    RETURN: none
+  */
+  void convertTime(Datetime &dtRecord);
+
+  /*
+    Format internal structure to text.
+
+    DESCRIPTION:
+    The method writes datetime from time keeping registers cache to the buffer
+    as a null terminated text in the demanded format.
+
+    PARAMETERS:
+    buffer - Pointer to the buffer for the text.
+      - Data type: pointer to char
+      - Default value: none
+      - Limited range: address space
+
+    format - Format of the text.
+      - Data type: DatetimeFormats
+      - Default value: none
+      - Limited range: DATETIME_ISO, DATETIME_COMPACT, DATETIME_RFC3339
+
+    RETURN: none
+  */
+  void formatRtcRecord(char *buffer, DatetimeFormats format);
+  // BCD digits map straight to ASCII
+  static inline char *formatBcd(char *buffer, uint8_t bcdValue)
+  {
+    *buffer++ = '0' + (bcdValue >> 4);
+    *buffer++ = '0' + (bcdValue & 0x0F);
+    return buffer;
+  }
+  // Binary value of a couple of decimal digits or 0xFF
+  static inline uint8_t parseDigits(const char *text)
+  {
+    uint8_t tens = text[0] - '0';
+    uint8_t units = text[1] - '0';
+    return tens > 9 || units > 9 ? 0xFF : 10 * tens + units;
   }
 
-  inline uint8_t bcd2bin(uint8_t bcdValue)
+  static constexpr uint8_t bcd2bin(uint8_t bcdValue)
   {
     return bcdValue - 6 * (bcdValue >> 4);
   }
-  inline uint8_t bin2bcd(uint8_t binValue)
+  static constexpr uint8_t bin2bcd(uint8_t binValue)
   {
     return binValue + 6 * (binValue / 10);
   }
+
+  /*
+    Descriptor of a time keeping register.
+
+    DESCRIPTION:
+    The template defines masking of a BCD value of a time keeping register and
+    its conversion, so that decoding and encoding compile down to a mask and
+    a multiplication without any branch.
+  */
+  template<uint8_t Mask>
+  struct RtcField
+  {
+    static constexpr uint8_t decode(uint8_t bcdValue)
+    {
+      return bcd2bin(bcdValue & Mask);
+    }
+    static constexpr uint8_t encode(uint8_t binValue)
+    {
+      return bin2bcd(binValue) & Mask;
+    }
+    static constexpr uint8_t digits(uint8_t bcdValue)
+    {
+      return bcdValue & Mask;
+    }
+  };
+  using FieldSecond = RtcField<0x7F>;
+  using FieldMinute = RtcField<0x7F>;
+  using FieldHour12 = RtcField<0x1F>;
+  using FieldHour24 = RtcField<0x3F>;
+  using FieldWeekday = RtcField<0x07>;
+  using FieldDay = RtcField<0x3F>;
+  using FieldMonth = RtcField<0x1F>;
+  using FieldYear = RtcField<0xFF>;
 };
 
 #endif
@@ -0,0 +1,85 @@
+#include "gbj_ds1307_fleet.h"
+
+bool gbj_ds1307_fleet::add(gbj_ds1307 *device, uint8_t channel)
+{
+  if (count_ >= Params::FLEET_SIZE)
+  {
+    return false;
+  }
+  members_[count_++] = { device, 0, 0, channel, false, false };
+  return true;
+}
+
+gbj_ds1307_fleet::ResultCodes gbj_ds1307_fleet::run()
+{
+  if (count_ == 0)
+  {
+    return ResultCodes::SUCCESS;
+  }
+  Member &member = members_[next_];
+  next_ = (next_ + 1) % count_;
+  if (member.channel != Params::CHANNEL_NONE && member.channel != channel_ &&
+      selector_ != nullptr)
+  {
+    selector_(member.channel);
+    channel_ = member.channel;
+  }
+  uint32_t epoch = 0;
+  ResultCodes result = member.device->getEpoch(epoch);
+  member.valid = member.device->isSuccess(result);
+  if (member.valid)
+  {
+    member.epoch = epoch;
+    member.timestamp = millis();
+  }
+  vote();
+  return result;
+}
+
+bool gbj_ds1307_fleet::getEpoch(uint32_t &epoch)
+{
+  uint32_t epochs[Params::FLEET_SIZE];
+  uint8_t valid = 0;
+  uint32_t now = millis();
+  // Insertion sort of extrapolated times
+  for (uint8_t i = 0; i < count_; i++)
+  {
+    if (!members_[i].valid)
+    {
+      continue;
+    }
+    uint32_t value = extrapolate(members_[i], now);
+    uint8_t j = valid++;
+    while (j > 0 && epochs[j - 1] > value)
+    {
+      epochs[j] = epochs[j - 1];
+      j--;
+    }
+    epochs[j] = value;
+  }
+  if (valid == 0)
+  {
+    return false;
+  }
+  epoch = epochs[(valid - 1) / 2];
+  return true;
+}
+
+void gbj_ds1307_fleet::vote()
+{
+  uint32_t median;
+  bool available = getEpoch(median);
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < count_; i++)
+  {
+    Member &member = members_[i];
+    if (!available || !member.valid)
+    {
+      member.outlier = false;
+      continue;
+    }
+    uint32_t value = extrapolate(member, now);
+    uint32_t diff = value > median ? value - median : median - value;
+    member.outlier = diff > tolerance_;
+  }
+}
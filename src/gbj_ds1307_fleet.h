@@ -0,0 +1,171 @@
+/*
+  NAME:
+  gbjDS1307 fleet
+
+  DESCRIPTION:
+  Manager of multiple real time clocks DS1307 on separate two-wire buses or
+  behind channels of a two-wire bus multiplexer for redundant timekeeping.
+
+  LICENSE:
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the license GNU GPL v3
+  http://www.gnu.org/licenses/gpl-3.0.html (related to original code) and MIT
+  License (MIT) for added code.
+
+  CREDENTIALS:
+  Author: Libor Gabaj
+  GitHub: https://github.com/mrkaleArduinoLib/gbj_ds1307.git
+*/
+#ifndef GBJ_DS1307_FLEET_H
+#define GBJ_DS1307_FLEET_H
+
+#include "gbj_ds1307.h"
+
+class gbj_ds1307_fleet
+{
+public:
+  // Handler selecting a multiplexer channel of a device
+  using Selector = void (*)(uint8_t channel);
+  using ResultCodes = gbj_ds1307::ResultCodes;
+  enum Params : uint8_t
+  {
+    // Maximal number of devices in a fleet
+    FLEET_SIZE = 4,
+    // Device without multiplexer channel
+    CHANNEL_NONE = 0xFF,
+  };
+
+  /*
+    Constructor.
+
+    DESCRIPTION:
+    Constructor stores the multiplexer channel selector and the tolerance of
+    devices' time for voting.
+
+    PARAMETERS:
+    selector - Pointer to a function switching a two-wire bus multiplexer to
+    the channel provided as its argument. It is called only for devices with
+    a channel and only if the channel differs from recently selected one.
+      - Data type: Selector
+      - Default value: nullptr
+      - Limited range: address space
+
+    tolerance - Maximal difference in seconds of a device's time from the
+    fleet median for considering the device as consistent.
+      - Data type: non-negative integer
+      - Default value: 2
+      - Limited range: 0 ~ 255
+
+    RETURN: object
+  */
+  gbj_ds1307_fleet(Selector selector = nullptr, uint8_t tolerance = 2)
+  {
+    selector_ = selector;
+    tolerance_ = tolerance;
+  }
+
+  /*
+    Add device to the fleet.
+
+    DESCRIPTION:
+    The method adds already initiated device to the fleet.
+
+    PARAMETERS:
+    device - Pointer to the device object.
+      - Data type: gbj_ds1307 pointer
+      - Default value: none
+      - Limited range: address space
+
+    channel - Multiplexer channel of the device.
+      - Data type: non-negative integer
+      - Default value: CHANNEL_NONE
+      - Limited range: 0 ~ 7, CHANNEL_NONE
+
+    RETURN: Flag about successful adding, false if the fleet is full
+  */
+  bool add(gbj_ds1307 *device, uint8_t channel = Params::CHANNEL_NONE);
+
+  /*
+    Read next device of the fleet.
+
+    DESCRIPTION:
+    The method reads epoch seconds from just one device in round-robin order,
+    so that reading the whole fleet costs one device reading per call. Times
+    of other devices are extrapolated from their recent readings by the
+    system time of the microcontroller.
+    - The method reevaluates the median time and outliers of the fleet.
+    - A device with failed reading is excluded from voting until its next
+    successful reading.
+
+    PARAMETERS: none
+
+    RETURN: Result code of the read device
+  */
+  ResultCodes run();
+
+  /*
+    Provide voted time of the fleet.
+
+    DESCRIPTION:
+    The method provides median epoch seconds of all successfully read
+    devices extrapolated to the current time without any communication on the
+    two-wire bus. For even number of devices it provides the lower median.
+
+    PARAMETERS:
+    epoch - Referenced variable for median Unix time.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0 ~ 2^32 - 1
+
+    RETURN: Flag about available time, false if no device has been read
+  */
+  bool getEpoch(uint32_t &epoch);
+
+  // Getters
+  inline uint8_t getCount() { return count_; }
+  inline uint8_t getTolerance() { return tolerance_; }
+  inline bool getValid(uint8_t index)
+  {
+    return index < count_ && members_[index].valid;
+  }
+  inline bool getOutlier(uint8_t index)
+  {
+    return index < count_ && members_[index].outlier;
+  }
+  inline uint8_t getOutliers()
+  {
+    uint8_t outliers = 0;
+    for (uint8_t i = 0; i < count_; i++)
+    {
+      outliers += members_[i].outlier;
+    }
+    return outliers;
+  }
+
+  // Setters
+  inline void setTolerance(uint8_t tolerance) { tolerance_ = tolerance; }
+
+private:
+  struct Member
+  {
+    gbj_ds1307 *device;
+    uint32_t epoch;
+    uint32_t timestamp;
+    uint8_t channel;
+    bool valid;
+    bool outlier;
+  } members_[Params::FLEET_SIZE];
+  Selector selector_;
+  uint8_t tolerance_;
+  uint8_t count_ = 0;
+  uint8_t next_ = 0;
+  uint8_t channel_ = Params::CHANNEL_NONE;
+
+  inline uint32_t extrapolate(const Member &member, uint32_t now)
+  {
+    return member.epoch + (now - member.timestamp) / 1000;
+  }
+  void vote();
+};
+
+#endif
@@ -0,0 +1,269 @@
+/*
+  NAME:
+  gbjDS1307 log
+
+  DESCRIPTION:
+  Ring log of records of any data type stored in non-volatile memory of the
+  real time clock DS1307.
+  - Each slot of the log consists of a sequence number, a record, and CRC-8
+    (Dallas/Maxim) checksum of them. Slots failing the checksum are ignored.
+  - The newest record is recognized by the break of sequence numbers in
+    consecutive valid slots, so that the log needs no separate header.
+  - Appending writes just one slot in one burst.
+  - Iterating takes a single bulk read of the entire log.
+
+  LICENSE:
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the license GNU GPL v3
+  http://www.gnu.org/licenses/gpl-3.0.html (related to original code) and MIT
+  License (MIT) for added code.
+
+  CREDENTIALS:
+  Author: Libor Gabaj
+  GitHub: https://github.com/mrkaleArduinoLib/gbj_ds1307.git
+*/
+#ifndef GBJ_DS1307_LOG_H
+#define GBJ_DS1307_LOG_H
+
+#include "gbj_ds1307.h"
+
+template<class T, uint8_t N>
+class gbj_ds1307_log
+{
+public:
+  // Handler processing a record of the log
+  using Visitor = void (*)(const T &record);
+  using ResultCodes = gbj_ds1307::ResultCodes;
+  enum Params : uint8_t
+  {
+    // Size of one slot in bytes
+    SLOT_SIZE = sizeof(T) + 2,
+    // Size of the log in non-volatile memory in bytes
+    LOG_SIZE = N * SLOT_SIZE,
+    // Maximal number of records in the log
+    LOG_CAPACITY = N,
+  };
+  static_assert(N >= 2, "Log needs at least two slots");
+  static_assert(static_cast<uint8_t>(LOG_SIZE) <=
+                  static_cast<uint8_t>(gbj_ds1307::Memory::MEMORY_SIZE),
+                "Log does not fit to the memory");
+
+  /*
+    Constructor.
+
+    DESCRIPTION:
+    Constructor stores the device and position of the log in its non-volatile
+    memory.
+
+    PARAMETERS:
+    device - Referenced already initiated device object.
+      - Data type: gbj_ds1307
+      - Default value: none
+      - Limited range: address space
+
+    position - Memory position of the log counted from the first byte of the
+    memory.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0 ~ MEMORY_SIZE - LOG_SIZE
+
+    RETURN: object
+  */
+  gbj_ds1307_log(gbj_ds1307 &device, uint8_t position)
+    : device_(device)
+  {
+    position_ = position;
+  }
+
+  /*
+    Load the log.
+
+    DESCRIPTION:
+    The method reads the entire log at once and finds its newest record and
+    number of records among slots with valid checksum.
+    - If no slot is valid, e.g., at the first usage of the memory, the log is
+    empty, but the method succeeds.
+
+    PARAMETERS: none
+
+    RETURN: Result code
+  */
+  ResultCodes begin()
+  {
+    uint8_t buffer[Params::LOG_SIZE];
+    if (device_.isError(
+          device_.retrieveNvram(position_, buffer, Params::LOG_SIZE)))
+    {
+      return device_.getLastResult();
+    }
+    scan(buffer);
+    return device_.getLastResult();
+  }
+
+  /*
+    Append record to the log.
+
+    DESCRIPTION:
+    The method writes the record with the next sequence number to the slot
+    after the newest record in one burst. If the log is full, the oldest
+    record is overwritten.
+    - If the memory mirror of the device is used, the method flushes it, so
+    that the record survives a crash right after appending.
+
+    PARAMETERS:
+    record - Referenced record to be appended.
+      - Data type: T
+      - Default value: none
+      - Limited range: any
+
+    RETURN: Result code
+  */
+  ResultCodes append(const T &record)
+  {
+    uint8_t buffer[Params::SLOT_SIZE];
+    buffer[0] = next(sequence_);
+    memcpy(buffer + 1, &record, sizeof(T));
+    buffer[Params::SLOT_SIZE - 1] =
+      gbj_ds1307::crc8(buffer, Params::SLOT_SIZE - 1);
+    if (device_.isError(device_.storeNvram(
+          position_ + head_ * Params::SLOT_SIZE, buffer, Params::SLOT_SIZE)) ||
+        device_.isError(device_.flushNvram()))
+    {
+      return device_.getLastResult();
+    }
+    sequence_ = buffer[0];
+    head_ = (head_ + 1) % N;
+    if (count_ < N)
+    {
+      count_++;
+    }
+    return device_.getLastResult();
+  }
+
+  /*
+    Process all records of the log.
+
+    DESCRIPTION:
+    The method reads the entire log at once and calls the handler for each
+    record from the oldest to the newest one. Records damaged since loading
+    the log are skipped.
+
+    PARAMETERS:
+    visitor - Pointer to a function processing a record provided as its
+    argument.
+      - Data type: Visitor
+      - Default value: none
+      - Limited range: address space
+
+    RETURN: Result code
+  */
+  ResultCodes iterate(Visitor visitor)
+  {
+    uint8_t buffer[Params::LOG_SIZE];
+    if (device_.isError(
+          device_.retrieveNvram(position_, buffer, Params::LOG_SIZE)))
+    {
+      return device_.getLastResult();
+    }
+    T record;
+    uint8_t slot = (head_ + N - count_) % N;
+    for (uint8_t i = 0; i < count_; i++)
+    {
+      const uint8_t *data = buffer + slot * Params::SLOT_SIZE;
+      slot = (slot + 1) % N;
+      if (!sequenceOf(data))
+      {
+        continue;
+      }
+      memcpy(&record, data + 1, sizeof(T));
+      visitor(record);
+    }
+    return device_.getLastResult();
+  }
+
+  /*
+    Remove all records from the log.
+
+    DESCRIPTION:
+    The method zeroes the entire memory area of the log in one burst, so that
+    no slot is valid.
+    - If the memory mirror of the device is used, the method flushes it.
+
+    PARAMETERS: none
+
+    RETURN: Result code
+  */
+  ResultCodes clear()
+  {
+    uint8_t buffer[Params::LOG_SIZE];
+    memset(buffer, 0, Params::LOG_SIZE);
+    if (device_.isError(
+          device_.storeNvram(position_, buffer, Params::LOG_SIZE)) ||
+        device_.isError(device_.flushNvram()))
+    {
+      return device_.getLastResult();
+    }
+    scan(buffer);
+    return device_.getLastResult();
+  }
+
+  // Getters
+  inline uint8_t getCount() { return count_; }
+
+private:
+  gbj_ds1307 &device_;
+  uint8_t position_;
+  uint8_t head_ = 0;
+  uint8_t count_ = 0;
+  uint8_t sequence_ = 0;
+
+  // Sequence numbers 1 ~ 255, zero marks an empty slot
+  static inline uint8_t next(uint8_t sequence)
+  {
+    return sequence == 0xFF ? 1 : sequence + 1;
+  }
+  // Sequence number of a slot, zero for a slot failing its checksum
+  static inline uint8_t sequenceOf(const uint8_t *slot)
+  {
+    return slot[Params::SLOT_SIZE - 1] ==
+               gbj_ds1307::crc8(slot, Params::SLOT_SIZE - 1)
+             ? slot[0]
+             : 0;
+  }
+  void scan(const uint8_t *buffer)
+  {
+    uint8_t sequences[N];
+    for (uint8_t i = 0; i < N; i++)
+    {
+      sequences[i] = sequenceOf(buffer + i * Params::SLOT_SIZE);
+    }
+    head_ = count_ = sequence_ = 0;
+    for (uint8_t i = 0; i < N; i++)
+    {
+      uint8_t sequence = sequences[i];
+      if (sequence == 0 || sequences[(i + 1) % N] == next(sequence))
+      {
+        continue;
+      }
+      // Newest record followed by a broken sequence
+      sequence_ = sequence;
+      head_ = (i + 1) % N;
+      count_ = 1;
+      uint8_t slot = i;
+      while (count_ < N)
+      {
+        uint8_t prev = (slot + N - 1) % N;
+        uint8_t value = sequences[prev];
+        if (value == 0 || next(value) != sequences[slot])
+        {
+          break;
+        }
+        slot = prev;
+        count_++;
+      }
+      break;
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,175 @@
+/*
+  NAME:
+  gbjDS1307 record
+
+  DESCRIPTION:
+  Integrity checked record of any data type stored in non-volatile memory of
+  the real time clock DS1307 in two alternating slots.
+  - Each slot consists of a sequence number, data, and CRC-8 (Dallas/Maxim)
+    checksum of them. The checksum starts from 0xFF, so that blank memory
+    filled with zeros or ones is never a valid slot.
+  - Committing writes just the inactive slot in one burst, so that a power
+    failure during writing damages at most the written slot and the recent
+    data remain valid in the other one.
+  - Validation takes a single bulk read of both slots.
+
+  LICENSE:
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the license GNU GPL v3
+  http://www.gnu.org/licenses/gpl-3.0.html (related to original code) and MIT
+  License (MIT) for added code.
+
+  CREDENTIALS:
+  Author: Libor Gabaj
+  GitHub: https://github.com/mrkaleArduinoLib/gbj_ds1307.git
+*/
+#ifndef GBJ_DS1307_RECORD_H
+#define GBJ_DS1307_RECORD_H
+
+#include "gbj_ds1307.h"
+
+template<class T>
+class gbj_ds1307_record
+{
+public:
+  using ResultCodes = gbj_ds1307::ResultCodes;
+  enum Params : uint8_t
+  {
+    // Size of one slot in bytes
+    SLOT_SIZE = sizeof(T) + 2,
+    // Size of the record in non-volatile memory in bytes
+    RECORD_SIZE = 2 * SLOT_SIZE,
+  };
+  static_assert(static_cast<uint8_t>(RECORD_SIZE) <=
+                  static_cast<uint8_t>(gbj_ds1307::Memory::MEMORY_SIZE),
+                "Record does not fit to the memory");
+
+  /*
+    Constructor.
+
+    DESCRIPTION:
+    Constructor stores the device and position of the record in its
+    non-volatile memory.
+
+    PARAMETERS:
+    device - Referenced already initiated device object.
+      - Data type: gbj_ds1307
+      - Default value: none
+      - Limited range: address space
+
+    position - Memory position of the record counted from the first byte of
+    the memory.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0 ~ MEMORY_SIZE - RECORD_SIZE
+
+    RETURN: object
+  */
+  gbj_ds1307_record(gbj_ds1307 &device, uint8_t position)
+    : device_(device)
+  {
+    position_ = position;
+  }
+
+  /*
+    Load the record.
+
+    DESCRIPTION:
+    The method reads both slots at once, validates their checksums, and takes
+    data from the valid slot with newer sequence number.
+    - If no slot is valid, e.g., at the first usage of the memory, the data
+    are zeroed and the record is flagged as invalid, but the method succeeds.
+
+    PARAMETERS: none
+
+    RETURN: Result code
+  */
+  ResultCodes begin()
+  {
+    uint8_t buffer[Params::RECORD_SIZE];
+    if (device_.isError(
+          device_.retrieveNvram(position_, buffer, Params::RECORD_SIZE)))
+    {
+      return device_.getLastResult();
+    }
+    const uint8_t *slotA = buffer;
+    const uint8_t *slotB = buffer + Params::SLOT_SIZE;
+    bool validA = checkSlot(slotA);
+    bool validB = checkSlot(slotB);
+    valid_ = validA || validB;
+    // Newer slot by sequence number with overflow
+    slot_ = validB && (!validA || static_cast<int8_t>(slotB[0] - slotA[0]) > 0);
+    if (valid_)
+    {
+      const uint8_t *slot = slot_ ? slotB : slotA;
+      sequence_ = slot[0];
+      memcpy(&data_, slot + 1, sizeof(T));
+    }
+    else
+    {
+      slot_ = 1;
+      sequence_ = 0;
+      memset(&data_, 0, sizeof(T));
+    }
+    return device_.getLastResult();
+  }
+
+  /*
+    Write data to the record.
+
+    DESCRIPTION:
+    The method writes data with the next sequence number and checksum to the
+    inactive slot in one burst, which becomes the active slot afterwards.
+    - If the memory mirror of the device is used, the method flushes it.
+
+    PARAMETERS:
+    data - Referenced data to be stored.
+      - Data type: T
+      - Default value: none
+      - Limited range: any
+
+    RETURN: Result code
+  */
+  ResultCodes commit(const T &data)
+  {
+    uint8_t buffer[Params::SLOT_SIZE];
+    buffer[0] = sequence_ + 1;
+    memcpy(buffer + 1, &data, sizeof(T));
+    buffer[Params::SLOT_SIZE - 1] =
+      gbj_ds1307::crc8(buffer, Params::SLOT_SIZE - 1);
+    uint8_t slot = !slot_;
+    if (device_.isError(device_.storeNvram(position_ + slot * Params::SLOT_SIZE,
+                                           buffer,
+                                           Params::SLOT_SIZE)) ||
+        device_.isError(device_.flushNvram()))
+    {
+      return device_.getLastResult();
+    }
+    slot_ = slot;
+    sequence_ = buffer[0];
+    data_ = data;
+    valid_ = true;
+    return device_.getLastResult();
+  }
+
+  // Getters
+  inline const T &getData() { return data_; }
+  inline bool getValid() { return valid_; }
+  inline uint8_t getSequence() { return sequence_; }
+
+private:
+  gbj_ds1307 &device_;
+  T data_;
+  uint8_t position_;
+  uint8_t sequence_ = 0;
+  uint8_t slot_ = 1;
+  bool valid_ = false;
+
+  inline bool checkSlot(const uint8_t *slot)
+  {
+    return gbj_ds1307::crc8(slot, Params::SLOT_SIZE - 1) ==
+           slot[Params::SLOT_SIZE - 1];
+  }
+};
+
+#endif
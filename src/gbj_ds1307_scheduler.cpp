@@ -0,0 +1,191 @@
+#include "gbj_ds1307_scheduler.h"
+
+bool gbj_ds1307_scheduler::add(uint8_t minute,
+                               uint8_t hour,
+                               uint8_t weekday,
+                               uint8_t day)
+{
+  Rule rule = { minute, hour, weekday, day };
+  if (count_ >= Params::SCHEDULER_SIZE || !checkRule(rule))
+  {
+    return false;
+  }
+  rules_[count_] = rule;
+  if (now_)
+  {
+    heap_[count_] = { schedule(rules_[count_], now_), count_ };
+    siftUp(count_);
+  }
+  count_++;
+  return true;
+}
+
+gbj_ds1307_scheduler::ResultCodes gbj_ds1307_scheduler::begin()
+{
+  ResultCodes result = device_.getEpoch(now_);
+  if (device_.isError(result))
+  {
+    now_ = 0;
+    return result;
+  }
+  for (uint8_t i = 0; i < count_; i++)
+  {
+    heap_[i] = { schedule(rules_[i], now_), i };
+    siftUp(i);
+  }
+  return result;
+}
+
+gbj_ds1307_scheduler::ResultCodes gbj_ds1307_scheduler::run()
+{
+  if (!now_)
+  {
+    return begin();
+  }
+  ResultCodes result = device_.getEpoch(now_);
+  if (device_.isError(result))
+  {
+    return result;
+  }
+  // Rules with passed deadline get rescheduled after now
+  while (count_ && heap_[0].next <= now_)
+  {
+    uint8_t index = heap_[0].index;
+    heap_[0].next = schedule(rules_[index], now_);
+    siftDown(0);
+    handler_(index);
+  }
+  return result;
+}
+
+gbj_ds1307_scheduler::ResultCodes gbj_ds1307_scheduler::store(uint8_t position)
+{
+  uint8_t buffer[Params::STORE_SIZE];
+  uint8_t len = 2 + 4 * count_;
+  buffer[0] = Params::STORE_MAGIC;
+  buffer[1] = count_;
+  memcpy(buffer + 2, rules_, 4 * count_);
+  buffer[len] = gbj_ds1307::crc8(buffer, len);
+  if (device_.isError(device_.storeNvram(position, buffer, len + 1)))
+  {
+    return device_.getLastResult();
+  }
+  return device_.flushNvram();
+}
+
+gbj_ds1307_scheduler::ResultCodes gbj_ds1307_scheduler::load(uint8_t position)
+{
+  uint8_t buffer[Params::STORE_SIZE];
+  count_ = 0;
+  if (device_.isError(
+        device_.retrieveNvram(position, buffer, Params::STORE_SIZE)))
+  {
+    return device_.getLastResult();
+  }
+  uint8_t len = 2 + 4 * buffer[1];
+  if (buffer[0] != Params::STORE_MAGIC || buffer[1] > Params::SCHEDULER_SIZE ||
+      buffer[len] != gbj_ds1307::crc8(buffer, len))
+  {
+    return device_.setLastResult(ResultCodes::ERROR_POSITION);
+  }
+  memcpy(rules_, buffer + 2, 4 * buffer[1]);
+  for (uint8_t i = 0; i < buffer[1]; i++)
+  {
+    if (!checkRule(rules_[i]))
+    {
+      return device_.setLastResult(ResultCodes::ERROR_POSITION);
+    }
+  }
+  count_ = buffer[1];
+  return begin();
+}
+
+bool gbj_ds1307_scheduler::checkRule(const Rule &rule)
+{
+  return (rule.minute <= 59 || rule.minute == Params::ANY) &&
+         (rule.hour <= 23 || rule.hour == Params::ANY) &&
+         ((rule.weekday >= 1 && rule.weekday <= 7) ||
+          rule.weekday == Params::ANY) &&
+         ((rule.day >= 1 && rule.day <= 31) || rule.day == Params::ANY);
+}
+
+uint32_t gbj_ds1307_scheduler::schedule(const Rule &rule, uint32_t epoch)
+{
+  // Search horizon for rare combinations of day and weekday
+  const uint16_t DAYS_LIMIT = 8 * 366;
+  // Local minutes since epoch of the first candidate minute
+  int32_t offset = 60L * device_.getTimezone();
+  uint32_t minutes = (epoch + offset) / 60 + 1;
+  uint32_t days = minutes / 1440;
+  uint16_t minuteOfDay = minutes % 1440;
+  for (uint16_t i = 0; i < DAYS_LIMIT; i++, days++, minuteOfDay = 0)
+  {
+    uint16_t year;
+    uint8_t month, day;
+    gbj_ds1307::civilFromDays(days, year, month, day);
+    // 1970-01-01 was Thursday
+    if ((rule.weekday != Params::ANY && rule.weekday != (days + 3) % 7 + 1) ||
+        (rule.day != Params::ANY && rule.day != day))
+    {
+      continue;
+    }
+    for (uint8_t hour = minuteOfDay / 60; hour < 24; hour++)
+    {
+      if (rule.hour != Params::ANY && rule.hour != hour)
+      {
+        continue;
+      }
+      uint8_t minute = hour == minuteOfDay / 60 ? minuteOfDay % 60 : 0;
+      if (rule.minute != Params::ANY)
+      {
+        if (rule.minute < minute)
+        {
+          continue;
+        }
+        minute = rule.minute;
+      }
+      return (days * 1440 + hour * 60UL + minute) * 60 - offset;
+    }
+  }
+  return NEVER;
+}
+
+void gbj_ds1307_scheduler::siftUp(uint8_t position)
+{
+  while (position > 0)
+  {
+    uint8_t parent = (position - 1) / 2;
+    if (heap_[parent].next <= heap_[position].next)
+    {
+      break;
+    }
+    Deadline swap = heap_[parent];
+    heap_[parent] = heap_[position];
+    heap_[position] = swap;
+    position = parent;
+  }
+}
+
+void gbj_ds1307_scheduler::siftDown(uint8_t position)
+{
+  for (;;)
+  {
+    uint8_t child = 2 * position + 1;
+    if (child >= count_)
+    {
+      break;
+    }
+    if (child + 1 < count_ && heap_[child + 1].next < heap_[child].next)
+    {
+      child++;
+    }
+    if (heap_[position].next <= heap_[child].next)
+    {
+      break;
+    }
+    Deadline swap = heap_[child];
+    heap_[child] = heap_[position];
+    heap_[position] = swap;
+    position = child;
+  }
+}
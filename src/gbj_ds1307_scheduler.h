@@ -0,0 +1,215 @@
+/*
+  NAME:
+  gbjDS1307 scheduler
+
+  DESCRIPTION:
+  Scheduler of periodic events with cron-like rules driven by the real time
+  clock DS1307, which has no alarm hardware.
+  - The scheduler precomputes the next deadline of each rule and keeps the
+    rules in a min-heap, so that checking the schedule costs just comparing
+    the current time with the earliest deadline.
+  - The rules can be persisted in non-volatile memory of the chip.
+
+  LICENSE:
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the license GNU GPL v3
+  http://www.gnu.org/licenses/gpl-3.0.html (related to original code) and MIT
+  License (MIT) for added code.
+
+  CREDENTIALS:
+  Author: Libor Gabaj
+  GitHub: https://github.com/mrkaleArduinoLib/gbj_ds1307.git
+*/
+#ifndef GBJ_DS1307_SCHEDULER_H
+#define GBJ_DS1307_SCHEDULER_H
+
+#include "gbj_ds1307.h"
+
+class gbj_ds1307_scheduler
+{
+public:
+  // Handler processing a rule of the index provided as its argument
+  using Handler = void (*)(uint8_t index);
+  using ResultCodes = gbj_ds1307::ResultCodes;
+  enum Params : uint8_t
+  {
+    // Maximal number of rules
+    SCHEDULER_SIZE = 8,
+    // Wildcard matching any value of a rule field
+    ANY = 0xFF,
+    // Size of the persisted schedule in non-volatile memory in bytes
+    STORE_SIZE = 3 + 4 * SCHEDULER_SIZE,
+    // Marker of the persisted schedule
+    STORE_MAGIC = 0x5C,
+  };
+  // Deadline of a rule without any matching time
+  static const uint32_t NEVER = 0xFFFFFFFF;
+
+  /*
+    Constructor.
+
+    DESCRIPTION:
+    Constructor stores the device and the handler of rules.
+
+    PARAMETERS:
+    device - Referenced already initiated device object.
+      - Data type: gbj_ds1307
+      - Default value: none
+      - Limited range: address space
+
+    handler - Pointer to a function called at reaching a deadline of a rule
+    with index of the rule in order of adding as its argument.
+      - Data type: Handler
+      - Default value: none
+      - Limited range: address space
+
+    RETURN: object
+  */
+  gbj_ds1307_scheduler(gbj_ds1307 &device, Handler handler)
+    : device_(device)
+  {
+    handler_ = handler;
+  }
+
+  /*
+    Add rule to the schedule.
+
+    DESCRIPTION:
+    The method adds a rule firing at the beginning of every minute matching all
+    its fields in local time of the device.
+    - A field with value ANY matches every value.
+    - If the scheduler has been already started, the deadline of the rule is
+    computed immediately, otherwise at starting the scheduler.
+
+    PARAMETERS:
+    minute - Minute of an hour.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0 ~ 59, ANY
+
+    hour - Hour of a day.
+      - Data type: non-negative integer
+      - Default value: ANY
+      - Limited range: 0 ~ 23, ANY
+
+    weekday - ISO weekday, i.e., Monday is 1 and Sunday is 7.
+      - Data type: non-negative integer
+      - Default value: ANY
+      - Limited range: 1 ~ 7, ANY
+
+    day - Day of a month.
+      - Data type: non-negative integer
+      - Default value: ANY
+      - Limited range: 1 ~ 31, ANY
+
+    RETURN: Flag about successful adding, false if the schedule is full or
+    a field is out of range
+  */
+  bool add(uint8_t minute,
+           uint8_t hour = Params::ANY,
+           uint8_t weekday = Params::ANY,
+           uint8_t day = Params::ANY);
+
+  /*
+    Start the scheduler.
+
+    DESCRIPTION:
+    The method computes deadlines of all rules from the current time of the
+    device and builds the heap of them.
+
+    PARAMETERS: none
+
+    RETURN: Result code
+  */
+  ResultCodes begin();
+
+  /*
+    Check the schedule.
+
+    DESCRIPTION:
+    The method compares the current time of the device with the earliest
+    deadline and calls the handler for all rules with passed deadline, which
+    are rescheduled afterwards. Each rule is fired at most once per call even
+    if it has missed multiple deadlines.
+    - The method obtains the time by the method getEpoch() of the device, so
+    that with the cache period or square wave signal attached it communicates
+    on the two-wire bus only at expiring the cache.
+
+    PARAMETERS: none
+
+    RETURN: Result code
+  */
+  ResultCodes run();
+
+  /*
+    Persist the schedule.
+
+    DESCRIPTION:
+    The method writes a magic byte, number of rules, their fields, and CRC-8
+    checksum of them to non-volatile memory of the device in one burst.
+    The handler is not persisted.
+    - If the memory mirror of the device is used, the method flushes it.
+
+    PARAMETERS:
+    position - Memory position of the schedule counted from the first byte of
+    the memory.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0 ~ MEMORY_SIZE - STORE_SIZE
+
+    RETURN: Result code
+  */
+  ResultCodes store(uint8_t position);
+
+  /*
+    Restore the schedule.
+
+    DESCRIPTION:
+    The method replaces all rules with those persisted in non-volatile memory
+    of the device read in one burst and starts the scheduler.
+    - If the persisted schedule has wrong magic byte or checksum, or some of
+    its rules is out of ranges accepted by the method add(), the schedule is
+    cleared and the method fails, e.g., at the first usage of the memory.
+
+    PARAMETERS:
+    position - Memory position of the schedule counted from the first byte of
+    the memory.
+      - Data type: non-negative integer
+      - Default value: none
+      - Limited range: 0 ~ MEMORY_SIZE - STORE_SIZE
+
+    RETURN: Result code, ERROR_POSITION for invalid persisted schedule
+  */
+  ResultCodes load(uint8_t position);
+
+  inline void clear() { count_ = 0; }
+
+  // Getters
+  inline uint8_t getCount() { return count_; }
+  inline uint32_t getNext() { return count_ ? heap_[0].next : NEVER; }
+
+private:
+  struct Rule
+  {
+    uint8_t minute;
+    uint8_t hour;
+    uint8_t weekday;
+    uint8_t day;
+  } rules_[Params::SCHEDULER_SIZE];
+  struct Deadline
+  {
+    uint32_t next;
+    uint8_t index;
+  } heap_[Params::SCHEDULER_SIZE];
+  gbj_ds1307 &device_;
+  Handler handler_;
+  uint32_t now_ = 0;
+  uint8_t count_ = 0;
+
+  static bool checkRule(const Rule &rule);
+  uint32_t schedule(const Rule &rule, uint32_t epoch);
+  void siftUp(uint8_t position);
+  void siftDown(uint8_t position);
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "gbj_memory.h"
+#include <stdlib.h>
+
+Ds1307Sim sim;
+TwoWire Wire;
+uint32_t simMillis = 0;
+void (*simIsr)() = nullptr;
+
+void yield()
+{
+  if (++simMillis % 1000 == 0)
+  {
+    sim.sqwEdge();
+  }
+}
+
+void Ds1307Sim::reset()
+{
+  memset(regs, 0, sizeof(regs));
+  // Power-up state of control register and halted clock on 2000-01-01
+  regs[0x00] = 0x80;
+  regs[0x03] = 0x01;
+  regs[0x04] = 0x01;
+  regs[0x05] = 0x01;
+  regs[0x07] = 0x03;
+  pointer = 0;
+  failAt = transactionMillis = 0;
+  stalled = false;
+  resetCounters();
+}
+
+void Ds1307Sim::resetCounters()
+{
+  starts = stops = bytesOut = bytesIn = reads = 0;
+}
+
+static uint8_t bcdIncrement(uint8_t &reg, uint8_t mask, uint8_t limit)
+{
+  uint8_t value = (reg & mask) >> 4 & 0x0F;
+  value = value * 10 + (reg & 0x0F) + 1;
+  bool carry = value > limit;
+  if (carry)
+  {
+    value = 0;
+  }
+  reg = (reg & ~(mask | 0x0F)) | ((value / 10) << 4) | (value % 10);
+  return carry;
+}
+
+void Ds1307Sim::tick(uint32_t seconds)
+{
+  // Halted clock does not move on
+  if (regs[0x00] & 0x80)
+  {
+    return;
+  }
+  while (seconds--)
+  {
+    if (bcdIncrement(regs[0x00], 0x70, 59) &&
+        bcdIncrement(regs[0x01], 0x70, 59))
+    {
+      bcdIncrement(regs[0x02], 0x30, 23);
+    }
+  }
+}
+
+void Ds1307Sim::elapse()
+{
+  for (uint32_t i = 0; i < transactionMillis; i++)
+  {
+    yield();
+  }
+}
+
+void Ds1307Sim::sqwEdge()
+{
+  if (stalled || regs[0x00] & 0x80)
+  {
+    return;
+  }
+  tick();
+  if ((regs[0x07] & 0x13) == 0x10 && simIsr != nullptr)
+  {
+    simIsr();
+  }
+}
+
+bool Ds1307Sim::write(const uint8_t *data, uint16_t len, bool stop)
+{
+  elapse();
+  if (++starts == failAt)
+  {
+    stops++;
+    return false;
+  }
+  stops += stop;
+  bytesOut += len;
+  pointer = data[0] % REGISTERS;
+  for (uint16_t i = 1; i < len; i++)
+  {
+    regs[pointer] = data[i];
+    pointer = (pointer + 1) % REGISTERS;
+  }
+  return true;
+}
+
+bool Ds1307Sim::read(uint8_t *data, uint16_t len, bool stop)
+{
+  elapse();
+  if (++starts == failAt)
+  {
+    stops++;
+    return false;
+  }
+  stops += stop;
+  bytesIn += len;
+  reads++;
+  for (uint16_t i = 0; i < len; i++)
+  {
+    data[i] = regs[pointer];
+    pointer = (pointer + 1) % REGISTERS;
+  }
+  return true;
+}
+
+// Datetime from strings in form of __DATE__ and __TIME__ macros
+void gbj_apphelpers::parseDateTime(Datetime &dtRecord,
+                                   const char *strDate,
+                                   const char *strTime)
+{
+  static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+  dtRecord.month = 1;
+  for (uint8_t i = 0; i < 12; i++)
+  {
+    if (strncmp(months + 3 * i, strDate, 3) == 0)
+    {
+      dtRecord.month = i + 1;
+    }
+  }
+  dtRecord.day = atoi(strDate + 4);
+  dtRecord.year = atoi(strDate + 7);
+  dtRecord.hour = atoi(strTime);
+  dtRecord.minute = atoi(strTime + 3);
+  dtRecord.second = atoi(strTime + 6);
+}
+
+void gbj_apphelpers::parseDateTime(Datetime &dtRecord,
+                                   const __FlashStringHelper *strDate,
+                                   const __FlashStringHelper *strTime)
+{
+  parseDateTime(dtRecord,
+                reinterpret_cast<const char *>(strDate),
+                reinterpret_cast<const char *>(strTime));
+}
@@ -0,0 +1,74 @@
+/*
+  NAME:
+  Host stub of gbjAppHelpers library with Arduino shims
+
+  DESCRIPTION:
+  Minimal replacement of the Arduino core and the application helpers library
+  for compiling the library on a host computer against the simulated chip.
+  - The system time is simulated and moved on by the test cases.
+*/
+#ifndef GBJ_APPHELPERS_H
+#define GBJ_APPHELPERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define B0 0
+#define B1 1
+#define B00 0
+#define B01 1
+#define B10 2
+#define B11 3
+#define INPUT 0x0
+#define INPUT_PULLUP 0x2
+#define FALLING 2
+#define constrain(amt, low, high)                                              \
+  ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// Simulated system time in milliseconds
+extern uint32_t simMillis;
+inline uint32_t millis() { return simMillis; }
+inline uint32_t micros() { return simMillis * 1000UL; }
+// Waiting moves the system time on and the chip with it at whole seconds
+void yield();
+// Attached interrupt handler of the square wave signal
+extern void (*simIsr)();
+inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+inline void pinMode(uint8_t, uint8_t) {}
+inline void attachInterrupt(int, void (*isr)(), int) { simIsr = isr; }
+inline void detachInterrupt(int) { simIsr = nullptr; }
+
+class __FlashStringHelper;
+
+struct TwoWire
+{
+  void begin() {}
+  void end() {}
+};
+extern TwoWire Wire;
+
+class gbj_apphelpers
+{
+public:
+  struct Datetime
+  {
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint8_t weekday;
+    bool mode12h;
+    bool pm;
+  };
+  static void parseDateTime(Datetime &dtRecord,
+                            const char *strDate,
+                            const char *strTime);
+  static void parseDateTime(Datetime &dtRecord,
+                            const __FlashStringHelper *strDate,
+                            const __FlashStringHelper *strTime);
+};
+
+#endif
@@ -0,0 +1,137 @@
+/*
+  NAME:
+  Host stub of gbjMemory library with simulated DS1307 chip
+
+  DESCRIPTION:
+  Replacement of the two-wire bus layer of the parent library routing bus
+  operations to a model of the register space of the chip.
+  - The model keeps all 64 registers with the register pointer wrapping from
+    the last one to the first one as the chip does.
+  - The model counts START conditions including repeated ones,
+    STOP conditions, and data bytes in both directions without address bytes.
+  - A transaction of a given ordinal number can be forced to fail.
+  - Transactions can take time and the oscillator can be stalled.
+*/
+#ifndef GBJ_MEMORY_H
+#define GBJ_MEMORY_H
+
+#include "gbj_apphelpers.h"
+
+struct Ds1307Sim
+{
+  static const uint8_t REGISTERS = 64;
+  uint8_t regs[REGISTERS];
+  uint8_t pointer;
+  // Counters
+  uint32_t starts;
+  uint32_t stops;
+  uint32_t bytesOut;
+  uint32_t bytesIn;
+  uint32_t reads;
+  // Ordinal number of a failing transaction, zero for none
+  uint32_t failAt;
+  // Milliseconds elapsing during each transaction, zero for none
+  uint32_t transactionMillis;
+  // Dead oscillator of enabled clock without seconds and square wave signal
+  bool stalled;
+
+  void reset();
+  void resetCounters();
+  // Move the running clock on by seconds within a day
+  void tick(uint32_t seconds = 1);
+  // Move the running clock on by one second with falling edge of the enabled
+  // square wave signal of 1 Hz
+  void sqwEdge();
+  // Let the time of a transaction elapse
+  void elapse();
+  bool write(const uint8_t *data, uint16_t len, bool stop);
+  bool read(uint8_t *data, uint16_t len, bool stop);
+};
+extern Ds1307Sim sim;
+
+class gbj_memory
+{
+public:
+  enum ClockSpeeds : uint32_t
+  {
+    CLOCK_100KHZ = 100000L,
+    CLOCK_400KHZ = 400000L,
+  };
+  enum ResultCodes : uint8_t
+  {
+    SUCCESS = 0,
+    ERROR_ADDR = 255,
+    ERROR_PINS = 254,
+    ERROR_RCV_DATA = 253,
+    ERROR_NACK_DATA = 3,
+    ERROR_POSITION = 252,
+  };
+
+  gbj_memory(ClockSpeeds clockSpeed, uint8_t, uint8_t)
+    : busClock_(clockSpeed)
+  {
+  }
+  inline ResultCodes begin(uint32_t, uint16_t, uint8_t) { return setLastResult(); }
+  inline void setPositionInBytes(uint8_t = 1) {}
+  inline ResultCodes registerAddress(uint8_t) { return setLastResult(); }
+  inline bool isSuccess(ResultCodes result) { return result == SUCCESS; }
+  inline bool isSuccess() { return isSuccess(lastResult_); }
+  inline bool isError(ResultCodes result) { return !isSuccess(result); }
+  inline bool isError() { return isError(lastResult_); }
+  inline ResultCodes getLastResult() { return lastResult_; }
+  inline ResultCodes setLastResult(ResultCodes result = SUCCESS)
+  {
+    return lastResult_ = result;
+  }
+  inline const char *getLastErrorTxt(const char *) { return ""; }
+  inline bool getBusStop() { return busStop_; }
+  inline void setBusStop() { busStop_ = true; }
+  inline void setBusRepeat() { busStop_ = false; }
+  inline void setBusStopFlag(bool busStop) { busStop_ = busStop; }
+  inline void setBusClock(ClockSpeeds clockSpeed) { busClock_ = clockSpeed; }
+  inline ClockSpeeds getBusClock() { return busClock_; }
+
+protected:
+  inline ResultCodes busSend(uint16_t command)
+  {
+    uint8_t data[] = { static_cast<uint8_t>(command) };
+    return transmit(data, sizeof(data));
+  }
+  inline ResultCodes busSend(uint16_t command, uint16_t value)
+  {
+    uint8_t data[] = { static_cast<uint8_t>(command),
+                       static_cast<uint8_t>(value) };
+    return transmit(data, sizeof(data));
+  }
+  inline ResultCodes busSendStreamPrefixed(uint8_t *stream,
+                                           uint16_t streamLen,
+                                           bool,
+                                           uint8_t *prefix,
+                                           uint16_t prefixLen,
+                                           bool,
+                                           bool = true)
+  {
+    uint8_t data[Ds1307Sim::REGISTERS + 2];
+    memcpy(data, prefix, prefixLen);
+    memcpy(data + prefixLen, stream, streamLen);
+    return transmit(data, prefixLen + streamLen);
+  }
+  inline ResultCodes busReceive(uint8_t *buffer, uint16_t len, uint8_t = 0)
+  {
+    return setLastResult(sim.read(buffer, len, busStop_) ? SUCCESS
+                                                         : ERROR_RCV_DATA);
+  }
+
+private:
+  ClockSpeeds busClock_;
+  ResultCodes lastResult_ = SUCCESS;
+  bool busStop_ = true;
+
+  inline ResultCodes transmit(const uint8_t *data, uint16_t len)
+  {
+    return setLastResult(sim.write(data, len, busStop_) ? SUCCESS
+                                                        : ERROR_NACK_DATA);
+  }
+};
+
+#endif
@@ -0,0 +1,1070 @@
+/*
+  NAME:
+  Host tests of gbjDS1307 library
+
+  DESCRIPTION:
+  The tests run the library against the simulated chip and check both the
+  results and the communication cost of operations, i.e., number of
+  starts and data bytes on the two-wire bus.
+  - The costs of operations listed in the benchmark sketch are verified here,
+    so that the sketch and the implementation cannot diverge.
+  - Build and run by the command "make" in this folder.
+*/
+#include "gbj_ds1307.h"
+#include "gbj_ds1307_fleet.h"
+#include "gbj_ds1307_log.h"
+#include "gbj_ds1307_record.h"
+#include "gbj_ds1307_scheduler.h"
+#include <stdio.h>
+
+static unsigned int checks = 0;
+static unsigned int failures = 0;
+
+#define CHECK(condition)                                                       \
+  do                                                                           \
+  {                                                                            \
+    checks++;                                                                  \
+    if (!(condition))                                                          \
+    {                                                                          \
+      failures++;                                                              \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);     \
+    }                                                                          \
+  } while (0)
+
+// Cost of operations since the recent reset of counters
+#define CHECK_COST(expStarts, expBytes)                                  \
+  do                                                                           \
+  {                                                                            \
+    CHECK(sim.starts == (expStarts));                              \
+    CHECK(sim.bytesOut + sim.bytesIn == (expBytes));                           \
+  } while (0)
+
+// Running clock at 2024-01-31 13:45:30 Wednesday in 24 hours mode
+static void startChip()
+{
+  sim.reset();
+  const uint8_t regs[] = { 0x30, 0x45, 0x13, 0x03, 0x31, 0x01, 0x24, 0x00 };
+  memcpy(sim.regs, regs, sizeof(regs));
+  simMillis = 1000;
+}
+
+static void testBenchmarkCosts()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  gbj_ds1307::Datetime dt;
+  uint8_t value;
+  uint32_t epoch;
+
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.begin()));
+  CHECK_COST(2, 1 + 8);
+  CHECK(sim.stops == 1);
+
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.getDateTime(dt)));
+  CHECK_COST(2, 1 + 8);
+
+  sim.resetCounters();
+  device.getSeconds(value);
+  CHECK_COST(2, 1 + 1);
+
+  sim.resetCounters();
+  device.getTimeOfDay(dt);
+  CHECK_COST(2, 1 + 3);
+
+  sim.resetCounters();
+  device.readConfiguration();
+  CHECK_COST(2, 1 + 1);
+
+  sim.resetCounters();
+  device.getEpoch(epoch);
+  CHECK_COST(2, 1 + 8);
+
+  device.getDateTime(dt);
+  sim.resetCounters();
+  device.setDateTime(dt);
+  CHECK_COST(1, 1 + 7);
+
+  sim.resetCounters();
+  device.stopClock();
+  device.startClock();
+  CHECK_COST(3 + 1, (1 + 1 + 2) + 2);
+
+  sim.resetCounters();
+  device.startSqw(device.SQW_RATE_1HZ);
+  device.startSqw(device.SQW_RATE_32KHZ);
+  CHECK_COST(2 * 1, 2 * 2);
+
+  sim.resetCounters();
+  device.retrieve(0, value);
+  CHECK_COST(2, 1 + 1);
+
+  sim.resetCounters();
+  device.store(0, value);
+  CHECK_COST(1, 1 + 1);
+}
+
+static void testDatetimeRoundTrip()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  gbj_ds1307::Datetime dt;
+  CHECK(device.isSuccess(device.getDateTime(dt)));
+  CHECK(dt.year == 2024 && dt.month == 1 && dt.day == 31);
+  CHECK(dt.hour == 13 && dt.minute == 45 && dt.second == 30);
+  CHECK(dt.weekday == 3 && !dt.mode12h);
+  dt.hour = 7;
+  dt.mode12h = true;
+  dt.pm = true;
+  CHECK(device.isSuccess(device.setDateTime(dt)));
+  // 12 hours mode, PM, 7 o'clock
+  CHECK(sim.regs[0x02] == 0x67);
+  char text[gbj_ds1307::DATETIME_SIZE];
+  device.getDateTime(text);
+  CHECK(strcmp(text, "2024-01-31T19:45:30") == 0);
+}
+
+static void testNvramBursts()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  uint8_t data[gbj_ds1307::MEMORY_SIZE];
+  uint8_t back[gbj_ds1307::MEMORY_SIZE];
+  for (uint8_t i = 0; i < sizeof(data); i++)
+  {
+    data[i] = i + 1;
+  }
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.storeNvram(0, data, sizeof(data))));
+  CHECK(memcmp(sim.regs + 0x08, data, sizeof(data)) == 0);
+  // Bursts of register address and at most 31 bytes, or all at once with a
+  // buffer exceeding the register space
+  if (GBJ_DS1307_WIRE_BUFFER == 32)
+  {
+    CHECK_COST(2, 2 + sizeof(data));
+  }
+  else
+  {
+    CHECK_COST(1, 1 + sizeof(data));
+  }
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.retrieveNvram(0, back, sizeof(back))));
+  CHECK(memcmp(back, data, sizeof(data)) == 0);
+  // Bursts of at most 32 bytes, or all at once
+  if (GBJ_DS1307_WIRE_BUFFER == 32)
+  {
+    CHECK_COST(4, 2 + sizeof(back));
+  }
+  else
+  {
+    CHECK_COST(2, 1 + sizeof(back));
+  }
+  CHECK(device.storeNvram(1, data, sizeof(data)) == device.ERROR_POSITION);
+}
+
+static void testBusError()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  gbj_ds1307::Datetime dt;
+  sim.failAt = sim.starts + 2;
+  CHECK(device.isError(device.getDateTime(dt)));
+  CHECK(device.isSuccess(device.getDateTime(dt)));
+}
+
+#ifdef GBJ_DS1307_STATS
+static void testStats()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  device.resetStats();
+  gbj_ds1307::Datetime dt;
+  gbj_ds1307::Stats stats;
+  CHECK(device.isSuccess(device.getDateTime(dt)));
+  device.getStats(device.STATS_DATETIME_READ, stats);
+  CHECK(stats.calls == 1 && stats.bytesOut == 1 && stats.bytesIn == 8);
+  // Failed transfers count the error but not bytes
+  sim.failAt = sim.starts + 2;
+  CHECK(device.getDateTime(dt) == device.ERROR_RCV_DATA);
+  sim.failAt = sim.starts + 1;
+  CHECK(device.getDateTime(dt) == device.ERROR_NACK_DATA);
+  device.getStats(device.STATS_DATETIME_READ, stats);
+  CHECK(stats.calls == 3 && stats.bytesOut == 2 && stats.bytesIn == 8);
+  CHECK(stats.errors[device.STATS_ERROR_RCV_DATA] == 1);
+  CHECK(stats.errors[device.STATS_ERROR_NACK_DATA] == 1);
+  CHECK(stats.errors[device.STATS_ERROR_OTHER] == 0);
+  device.getStats(device.STATS_REGISTERS_WRITE, stats);
+  CHECK(stats.calls == 0);
+  device.setDateTime(dt);
+  device.getStats(device.STATS_REGISTERS_WRITE, stats);
+  CHECK(stats.calls == 1 && stats.bytesOut == 1 + 7 && stats.bytesIn == 0);
+}
+#endif
+
+static void testCacheResync()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  device.setCachePeriod(10000);
+  gbj_ds1307::Datetime dt;
+  sim.resetCounters();
+  // Polling at 10 Hz for 60 seconds
+  for (uint16_t i = 1; i <= 600; i++)
+  {
+    simMillis += 100;
+    if (i % 10 == 0)
+    {
+      sim.tick();
+    }
+    CHECK(device.isSuccess(device.getDateTime(dt)));
+  }
+  CHECK(sim.reads == 6);
+  CHECK(dt.minute == 46 && dt.second == 30);
+  // Asynchronous reading expires the cache in the same way
+  sim.resetCounters();
+  for (uint16_t i = 1; i <= 600; i++)
+  {
+    simMillis += 100;
+    device.beginReadDateTime();
+    while (!device.poll())
+      ;
+  }
+  CHECK(sim.reads == 6);
+}
+
+static void testSqw()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  gbj_ds1307 other = gbj_ds1307();
+  device.begin();
+  other.begin();
+  gbj_ds1307::Datetime dt;
+  // Attaching waits for the first edge and reads the chip right after it
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.attachSqw(2)));
+  CHECK(device.getSqwAttached() && sim.regs[0x07] == 0x10);
+  CHECK_COST(1 + 2, 2 + (1 + 8));
+  CHECK(simMillis == 2000 && sim.regs[0x00] == 0x31);
+  // Another device cannot take over the interrupt handler
+  CHECK(other.attachSqw(3) == other.ERROR_PINS);
+  CHECK(!other.getSqwAttached() && device.getSqwAttached());
+  other.detachSqw();
+  // Edges move the datetime on without any bus communication
+  for (uint8_t i = 0; i < 5; i++)
+  {
+    sim.sqwEdge();
+  }
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.getDateTime(dt)));
+  CHECK(dt.minute == 45 && dt.second == 36);
+  CHECK_COST(0, 0);
+  // Released interrupt handler serves another device
+  device.detachSqw();
+  CHECK(!device.getSqwAttached());
+  CHECK(other.isSuccess(other.attachSqw(3)));
+  sim.sqwEdge();
+  sim.resetCounters();
+  CHECK(other.isSuccess(other.getDateTime(dt)));
+  CHECK(dt.second == 38);
+  CHECK_COST(0, 0);
+}
+
+static void testSyncTimestamp()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  // Polling seconds register taking 10 ms per transaction
+  sim.transactionMillis = 10;
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.syncTimestamp()));
+  CHECK(simMillis == 2020 && sim.regs[0x00] == 0x31);
+  // Anchor right after the increment before reading the whole datetime
+  CHECK(device.getTimestamp() == 1706708731ULL * 1000000 + 20000);
+  // Halted clock fails at once
+  device.stopClock();
+  uint32_t timestamp = simMillis;
+  sim.resetCounters();
+  CHECK(device.syncTimestamp() == device.ERROR_RCV_DATA);
+  CHECK(sim.reads == 1 && simMillis - timestamp == 20);
+  // Stalled oscillator fails after the waiting limit
+  device.startClock();
+  sim.stalled = true;
+  timestamp = simMillis;
+  CHECK(device.syncTimestamp() == device.ERROR_RCV_DATA);
+  CHECK(simMillis - timestamp >= 1100 && simMillis - timestamp < 1200);
+  // Square wave signal aligns without bus communication
+  startChip();
+  device.begin();
+  CHECK(device.isSuccess(device.attachSqw(2)));
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.syncTimestamp()));
+  CHECK_COST(0, 0);
+  CHECK(simMillis == 3000);
+  CHECK(device.getTimestamp() == 1706708732ULL * 1000000);
+  device.stopClock();
+  timestamp = simMillis;
+  CHECK(device.syncTimestamp() == device.ERROR_RCV_DATA);
+  CHECK(simMillis == timestamp);
+  device.startClock();
+  sim.stalled = true;
+  CHECK(device.syncTimestamp() == device.ERROR_RCV_DATA);
+  CHECK(simMillis - timestamp >= 1100 && simMillis - timestamp < 1200);
+  device.detachSqw();
+}
+
+static void testAsyncRead()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  gbj_ds1307::Datetime dt;
+  uint8_t value;
+  memset(sim.regs + 0x08, 0x19, gbj_ds1307::MEMORY_SIZE);
+  // Synchronous reading between steps moves the register pointer
+  sim.tick(5);
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.beginReadDateTime()));
+  CHECK(!device.poll());
+  CHECK(device.isSuccess(device.retrieve(0, value)));
+  CHECK(!device.poll());
+  CHECK(device.poll());
+  CHECK(device.isSuccess());
+  device.convertDateTime(dt);
+  CHECK(dt.year == 2024 && dt.month == 1 && dt.second == 35);
+  CHECK_COST(1 + 2 + 2, 1 + (1 + 1) + 1 + 8);
+  // Verified reading repeats inconsistent registers and then fails
+  device.setVerifyRead(true);
+  sim.regs[0x01] = 0x7A;
+  sim.resetCounters();
+  device.beginReadDateTime();
+  while (!device.poll())
+    ;
+  CHECK(device.getLastResult() == device.ERROR_RCV_DATA);
+  CHECK(sim.reads == 3);
+  // Seconds 59 cost one more step with the seconds register
+  sim.regs[0x01] = 0x45;
+  sim.regs[0x00] = 0x59;
+  sim.resetCounters();
+  device.beginReadDateTime();
+  uint8_t steps = 1;
+  while (!device.poll())
+  {
+    steps++;
+  }
+  CHECK(device.isSuccess());
+  CHECK(steps == 3 && sim.reads == 2);
+  device.convertDateTime(dt);
+  CHECK(dt.minute == 45 && dt.second == 59);
+  // Failed steps fall back from the tuned bus clock
+  gbj_ds1307 tuned = gbj_ds1307();
+  tuned.setBusTuning(true);
+  CHECK(tuned.isSuccess(tuned.begin()));
+  CHECK(tuned.getBusTuned());
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    sim.failAt = sim.starts + 1;
+    tuned.beginReadDateTime();
+    CHECK(tuned.poll());
+    CHECK(tuned.isError());
+  }
+  CHECK(!tuned.getBusTuned());
+}
+
+static void testClockSwitch()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.stopClock()));
+  CHECK(sim.regs[0x00] == 0xB0);
+  CHECK(!device.getClockEnabled());
+  // Halted clock known from the recent write is not read again
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.startClock()));
+  CHECK(sim.regs[0x00] == 0x30);
+  CHECK_COST(1, 2);
+  // Running clock is read for current seconds and not written
+  sim.tick(5);
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.startClock()));
+  CHECK_COST(2, 2);
+  // Failed write makes the clock halt bit unknown
+  sim.failAt = sim.starts + 3;
+  CHECK(device.isError(device.stopClock()));
+  sim.regs[0x00] = 0xB5;
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.startClock()));
+  CHECK(sim.regs[0x00] == 0x35);
+  CHECK_COST(3, 4);
+}
+
+static void testPendingCommit()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  gbj_ds1307::Datetime dt;
+  // Pending clock halt survives reading and does not rewind seconds
+  device.configClockDisable();
+  sim.tick(10);
+  CHECK(device.isSuccess(device.getDateTime(dt)));
+  CHECK(dt.second == 40);
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.commit()));
+  CHECK(sim.regs[0x00] == 0xC0);
+  CHECK_COST(1, 1 + 1);
+  // Pending square wave rate survives reading
+  device.configSqwRate(device.SQW_RATE_4KHZ);
+  CHECK(device.isSuccess(device.getDateTime(dt)));
+  CHECK(device.isSuccess(device.readConfiguration()));
+  CHECK(device.getSqwRate() == device.SQW_RATE_4KHZ);
+  CHECK(device.isSuccess(device.commit()));
+  CHECK(sim.regs[0x07] == 0x01);
+  // Pending hours survive asynchronous and batch readings
+  dt.hour = 8;
+  device.configDateTime(dt);
+  device.beginReadDateTime();
+  while (!device.poll())
+    ;
+  gbj_ds1307::Batch batch;
+  device.batchDateTime(batch);
+  CHECK(device.isSuccess(device.runBatch(batch)));
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.commit()));
+  CHECK(sim.regs[0x02] == 0x08 && sim.regs[0x01] == 0x45);
+  CHECK_COST(1, 1 + 1);
+}
+
+static void testBatch()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  uint8_t mirror[gbj_ds1307::MEMORY_SIZE];
+  device.setNvramMirror(mirror);
+  device.begin();
+  gbj_ds1307::Batch batch;
+  uint8_t value = 0xAA;
+  uint8_t back;
+  // Written memory is mirrored
+  CHECK(batch.write(0x08, &value, 1));
+  CHECK(device.isSuccess(device.runBatch(batch)));
+  CHECK(sim.regs[0x08] == 0xAA);
+  CHECK(device.isSuccess(device.retrieve(0, back)));
+  CHECK(back == 0xAA);
+  // Failed batch keeps the configuration pending
+  device.configSqwEnable();
+  CHECK(device.batchConfiguration(batch));
+  sim.failAt = sim.starts + 1;
+  CHECK(device.isError(device.runBatch(batch)));
+  CHECK(sim.regs[0x07] == 0x00);
+  CHECK(device.isSuccess(device.setConfiguration()));
+  CHECK(sim.regs[0x07] == 0x10);
+  // Span wrapping to the seconds register is rejected
+  uint8_t buffer[2] = {};
+  CHECK(!batch.write(0x3F, buffer, 2));
+  CHECK(!batch.read(0x3F, buffer, 2));
+  CHECK(batch.read(0x3E, buffer, 2));
+  CHECK(batch.getCount() == 1);
+}
+
+static void testRecord()
+{
+  struct Data
+  {
+    uint16_t counter;
+    uint8_t flags;
+  };
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  // Blank memory is not a valid record
+  for (uint8_t fill = 0; fill < 2; fill++)
+  {
+    memset(sim.regs + 0x08, fill ? 0xFF : 0x00, gbj_ds1307::MEMORY_SIZE);
+    gbj_ds1307_record<Data> blank(device, 4);
+    CHECK(device.isSuccess(blank.begin()));
+    CHECK(!blank.getValid());
+  }
+  gbj_ds1307_record<Data> record(device, 4);
+  record.begin();
+  Data data = { 1234, 0x5A };
+  CHECK(device.isSuccess(record.commit(data)));
+  data.counter++;
+  CHECK(device.isSuccess(record.commit(data)));
+  // Damaged newer slot falls back to the older one
+  gbj_ds1307_record<Data> reload(device, 4);
+  CHECK(device.isSuccess(reload.begin()));
+  CHECK(reload.getValid() && reload.getData().counter == 1235);
+  sim.regs[0x08 + 4 + reload.SLOT_SIZE + 1] ^= 0x01;
+  CHECK(device.isSuccess(reload.begin()));
+  CHECK(reload.getValid() && reload.getData().counter == 1234);
+}
+
+static uint16_t logSum;
+static void logVisit(const uint16_t &record) { logSum = logSum * 10 + record; }
+static void scheduleHandle(uint8_t) {}
+
+static void testPersistenceWithMirror()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  uint8_t mirror[gbj_ds1307::MEMORY_SIZE];
+  device.setNvramMirror(mirror);
+  device.begin();
+  gbj_ds1307_log<uint16_t, 4> log(device, 0);
+  CHECK(device.isSuccess(log.clear()));
+  CHECK(sim.regs[0x08] == 0 && !device.getNvramDirty());
+  for (uint16_t i = 1; i <= 5; i++)
+  {
+    CHECK(device.isSuccess(log.append(i)));
+    // Appended record reaches the chip at once
+    CHECK(!device.getNvramDirty());
+  }
+  // Log restored from the chip only
+  gbj_ds1307 rebooted = gbj_ds1307();
+  rebooted.begin();
+  gbj_ds1307_log<uint16_t, 4> reload(rebooted, 0);
+  CHECK(rebooted.isSuccess(reload.begin()));
+  CHECK(reload.getCount() == 4);
+  logSum = 0;
+  reload.iterate(logVisit);
+  CHECK(logSum == 2345);
+  gbj_ds1307_scheduler scheduler(device, scheduleHandle);
+  CHECK(scheduler.add(30, 6));
+  CHECK(device.isSuccess(scheduler.store(20)));
+  CHECK(!device.getNvramDirty());
+  CHECK(sim.regs[0x08 + 20] == scheduler.STORE_MAGIC &&
+        sim.regs[0x08 + 21] == 1 && sim.regs[0x08 + 22] == 30);
+  CHECK(sim.regs[0x08 + 26] == gbj_ds1307::crc8(&sim.regs[0x08 + 20], 6));
+  gbj_ds1307_scheduler restored(rebooted, scheduleHandle);
+  CHECK(rebooted.isSuccess(restored.load(20)));
+  CHECK(restored.getCount() == 1);
+  // Damaged checksum and a rule out of range with valid checksum are refused
+  sim.regs[0x08 + 26] ^= 0x01;
+  CHECK(restored.load(20) == rebooted.ERROR_POSITION);
+  CHECK(restored.getCount() == 0);
+  sim.regs[0x08 + 22] = 60;
+  sim.regs[0x08 + 26] = gbj_ds1307::crc8(&sim.regs[0x08 + 20], 6);
+  CHECK(restored.load(20) == rebooted.ERROR_POSITION);
+  CHECK(restored.getCount() == 0);
+}
+
+static void testLogValidation()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  // Blank memory of ones has no valid slot
+  memset(&sim.regs[0x08], 0xFF, gbj_ds1307::MEMORY_SIZE);
+  gbj_ds1307_log<uint16_t, 4> log(device, 0);
+  CHECK(device.isSuccess(log.begin()));
+  CHECK(log.getCount() == 0);
+  for (uint16_t i = 1; i <= 5; i++)
+  {
+    CHECK(device.isSuccess(log.append(i)));
+  }
+  CHECK(sim.regs[0x08 + 3] == gbj_ds1307::crc8(&sim.regs[0x08], 3));
+  // Damaged newest record falls back to the previous one
+  sim.regs[0x08 + 1] ^= 0x01;
+  CHECK(device.isSuccess(log.begin()));
+  CHECK(log.getCount() == 3);
+  logSum = 0;
+  log.iterate(logVisit);
+  CHECK(logSum == 234);
+  // Damaged record breaks the chain of older records
+  sim.regs[0x08 + 1] ^= 0x01;
+  sim.regs[0x08 + 2 * log.SLOT_SIZE + 1] ^= 0x01;
+  CHECK(device.isSuccess(log.begin()));
+  CHECK(log.getCount() == 2);
+  logSum = 0;
+  log.iterate(logVisit);
+  CHECK(logSum == 45);
+  // Record damaged after loading is skipped
+  CHECK(device.isSuccess(log.append(6)));
+  CHECK(log.getCount() == 3);
+  sim.regs[0x08 + 0 * log.SLOT_SIZE + 1] ^= 0x01;
+  logSum = 0;
+  log.iterate(logVisit);
+  CHECK(logSum == 46);
+}
+
+static void testVerifiedRead()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  device.setVerifyRead(true);
+  device.setCachePeriod(10000);
+  gbj_ds1307::Datetime dt;
+  // Invalid minutes are read repeatedly and never cached
+  sim.regs[0x01] = 0x7A;
+  simMillis += 20000;
+  sim.resetCounters();
+  CHECK(device.getDateTime(dt) == device.ERROR_RCV_DATA);
+  CHECK(sim.reads == 3);
+  sim.regs[0x01] = 0x45;
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.getDateTime(dt)));
+  CHECK(sim.reads == 1 && dt.minute == 45);
+  // Carry after seconds 59 is detected by the repeated seconds reading
+  sim.regs[0x00] = 0x59;
+  device.setCachePeriod(0);
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.getDateTime(dt)));
+  CHECK(sim.reads == 2 && dt.second == 59);
+}
+
+// Drift record with magic byte and checksum at the memory position 0
+static void storeDriftRecord(uint32_t epoch, int32_t drift)
+{
+  uint8_t *record = sim.regs + 0x08;
+  record[0] = 0xD7;
+  memcpy(record + 1, &epoch, sizeof(epoch));
+  memcpy(record + 5, &drift, sizeof(drift));
+  record[9] = gbj_ds1307::crc8(record, 9);
+}
+
+static void testDrift()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  gbj_ds1307::Datetime dt;
+  // Blank memory is no drift record
+  for (uint8_t fill = 0; fill < 2; fill++)
+  {
+    memset(sim.regs + 0x08, fill ? 0xFF : 0x00, gbj_ds1307::MEMORY_SIZE);
+    CHECK(device.isSuccess(device.beginDrift(0)));
+    CHECK(device.getDrift() == 0);
+  }
+  // Record without magic byte, damaged one, or out of years 2000 ~ 2099
+  const uint8_t crafted[] = { 0x80, 0x43, 0x6D, 0x38, 0xA0, 0xBB, 0x0D, 0x00 };
+  memcpy(sim.regs + 0x08, crafted, sizeof(crafted));
+  CHECK(device.isSuccess(device.beginDrift(0)));
+  CHECK(device.getDrift() == 0);
+  storeDriftRecord(1706708730UL, 20000);
+  sim.regs[0x08 + 3] ^= 0x01;
+  CHECK(device.isSuccess(device.beginDrift(0)));
+  CHECK(device.getDrift() == 0);
+  storeDriftRecord(0xFFFFFFFF, 20000);
+  CHECK(device.isSuccess(device.beginDrift(0)));
+  CHECK(device.getDrift() == 0);
+  // Implausible drift is limited to 500 ppm
+  storeDriftRecord(1706708730UL - 86400, 900000L);
+  CHECK(device.isSuccess(device.beginDrift(0)));
+  CHECK(device.getDrift() == 500000L);
+  CHECK(device.isSuccess(device.getDateTime(dt)));
+  CHECK(dt.day == 31 && dt.hour == 13 && dt.minute == 44 && dt.second == 47);
+  // Measured drift of the chip ahead by 1 second in 2 hours survives restart
+  memset(sim.regs + 0x08, 0x00, gbj_ds1307::MEMORY_SIZE);
+  CHECK(device.isSuccess(device.beginDrift(0)));
+  uint32_t reference = 1706708730UL;
+  CHECK(device.isSuccess(device.syncEpoch(reference)));
+  CHECK(device.getDrift() == 0 && sim.regs[0x08] == 0xD7);
+  sim.tick(7200);
+  simMillis += 7200000UL;
+  CHECK(device.isSuccess(device.syncEpoch(reference + 7199)));
+  CHECK(device.getDrift() == 1000000000L / 7199);
+  gbj_ds1307 rebooted = gbj_ds1307();
+  rebooted.begin();
+  CHECK(rebooted.isSuccess(rebooted.beginDrift(0)));
+  CHECK(rebooted.getDrift() == 1000000000L / 7199);
+}
+
+static void testSleepWake()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  device.setCachePeriod(60000);
+  gbj_ds1307::Datetime dt;
+  CHECK(device.isSuccess(device.attachSqw(2)));
+  // An hour of sleep without edges and system time
+  CHECK(device.isSuccess(device.sleep()));
+  sim.tick(3600);
+  CHECK(device.isSuccess(device.wake()));
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.getDateTime(dt)));
+  CHECK(dt.hour == 14 && dt.minute == 45 && dt.second == 31);
+  CHECK_COST(2, 1 + 8);
+  // Edges after the reading move the cache on again
+  sim.sqwEdge();
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.getDateTime(dt)));
+  CHECK(dt.second == 32);
+  CHECK_COST(0, 0);
+  // Without the signal the cache expires by the wake up as well
+  device.detachSqw();
+  CHECK(device.isSuccess(device.sleep()));
+  sim.tick(60);
+  CHECK(device.isSuccess(device.wake()));
+  CHECK(device.isSuccess(device.getDateTime(dt)));
+  CHECK(dt.minute == 46 && dt.second == 32);
+}
+
+static void testSleepPeriod()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  uint32_t epoch, period;
+  CHECK(device.isSuccess(device.getEpoch(epoch)));
+  CHECK(device.isSuccess(device.getSleepPeriod(epoch + 60, period)));
+  CHECK(period == 60000);
+  CHECK(device.isSuccess(device.getSleepPeriod(epoch - 1, period)));
+  CHECK(period == 0);
+  // The longest period representable in milliseconds and beyond it
+  CHECK(device.isSuccess(device.getSleepPeriod(epoch + 4294967, period)));
+  CHECK(period == 4294967000UL);
+  CHECK(device.isSuccess(device.getSleepPeriod(epoch + 4294968, period)));
+  CHECK(period == 0xFFFFFFFF);
+  CHECK(device.isSuccess(device.getSleepPeriod(epoch + 100 * 86400, period)));
+  CHECK(period == 0xFFFFFFFF);
+}
+
+static void testConfigDateTime()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  gbj_ds1307::Datetime dt;
+  CHECK(device.isSuccess(device.getDateTime(dt)));
+  // Unchanged datetime is not written at all
+  device.configDateTime(dt);
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.commit()));
+  CHECK_COST(0, 0);
+  // Just the span of changed registers is written
+  dt.minute = 50;
+  device.configDateTime(dt);
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.commit()));
+  CHECK(sim.regs[0x01] == 0x50);
+  CHECK_COST(1, 1 + 1);
+  dt.hour = 14;
+  dt.year = 2025;
+  device.configDateTime(dt);
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.commit()));
+  CHECK(sim.regs[0x02] == 0x14 && sim.regs[0x06] == 0x25);
+  CHECK_COST(1, 1 + 5);
+}
+
+static void testBcdDatetime()
+{
+  constexpr gbj_ds1307::BcdDatetime bcd("Jan 31 2024", "13:45:30");
+  static_assert(bcd.second == 0x30 && bcd.minute == 0x45 && bcd.hour == 0x13,
+                "BCD time at compile time");
+  static_assert(bcd.day == 0x31 && bcd.month == 0x01 && bcd.year == 0x24,
+                "BCD date at compile time");
+  static_assert(bcd.hour12 == 0x61, "BCD 12 hours mode at compile time");
+  constexpr gbj_ds1307::BcdDatetime padded("Feb  5 2024", "00:05:09");
+  static_assert(padded.day == 0x05 && padded.month == 0x02, "Padded day");
+  static_assert(padded.hour12 == 0x52, "Midnight in 12 hours mode");
+  // Registers written at once without any conversion
+  sim.reset();
+  simMillis = 1000;
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.startClock(bcd, 3)));
+  const uint8_t regs[] = { 0x30, 0x45, 0x13, 0x03, 0x31, 0x01, 0x24 };
+  CHECK(memcmp(sim.regs, regs, sizeof(regs)) == 0);
+  CHECK_COST(1, 1 + 7);
+  CHECK(device.isSuccess(device.startClock(bcd, 3, true)));
+  CHECK(sim.regs[0x02] == 0x61);
+}
+
+static void testEpochRoundTrip()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  uint32_t epoch = 0;
+  // Leap day written in one burst with ISO weekday
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.setEpoch(1709164800UL)));
+  const uint8_t regs[] = { 0x00, 0x00, 0x00, 0x04, 0x29, 0x02, 0x24 };
+  CHECK(memcmp(sim.regs, regs, sizeof(regs)) == 0);
+  CHECK_COST(1, 1 + 7);
+  sim.tick(5);
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.getEpoch(epoch)));
+  CHECK(epoch == 1709164805UL);
+  CHECK_COST(2, 1 + 8);
+  // Local time of the time zone in registers, Unix time in the interface
+  device.setTimezone(-60);
+  CHECK(device.isSuccess(device.setEpoch(4102444799UL)));
+  CHECK(sim.regs[0x02] == 0x22 && sim.regs[0x04] == 0x31 &&
+        sim.regs[0x05] == 0x12 && sim.regs[0x06] == 0x99);
+  CHECK(device.isSuccess(device.getEpoch(epoch)));
+  CHECK(epoch == 4102444799UL);
+}
+
+// Chips behind a multiplexer sharing the simulated one
+static uint8_t fleetChips[3][8];
+static uint8_t fleetChannel;
+static void fleetSelect(uint8_t channel)
+{
+  if (fleetChannel < 3)
+  {
+    memcpy(fleetChips[fleetChannel], sim.regs, 8);
+  }
+  memcpy(sim.regs, fleetChips[channel], 8);
+  fleetChannel = channel;
+}
+
+static void testFleet()
+{
+  startChip();
+  memcpy(fleetChips[0], sim.regs, 8);
+  memcpy(fleetChips[1], sim.regs, 8);
+  memcpy(fleetChips[2], sim.regs, 8);
+  fleetChips[1][0x00] = 0x31;
+  fleetChips[2][0x00] = 0x00;
+  fleetChips[2][0x01] = 0x50;
+  fleetChannel = 0xFF;
+  gbj_ds1307 devices[3] = { gbj_ds1307(), gbj_ds1307(), gbj_ds1307() };
+  gbj_ds1307_fleet fleet(fleetSelect);
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    fleetSelect(i);
+    devices[i].begin();
+    CHECK(fleet.add(&devices[i], i));
+  }
+  // Each run reads just one member
+  sim.resetCounters();
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    CHECK(devices[i].isSuccess(fleet.run()));
+  }
+  CHECK_COST(3 * 2, 3 * (1 + 8));
+  // Median wins and the distant member is an outlier
+  uint32_t epoch = 0;
+  CHECK(fleet.getEpoch(epoch));
+  CHECK(epoch == 1706708731UL);
+  CHECK(!fleet.getOutlier(0) && !fleet.getOutlier(1) && fleet.getOutlier(2));
+  CHECK(fleet.getOutliers() == 1);
+  // Failed member does not vote
+  sim.failAt = sim.starts + 2;
+  CHECK(devices[0].isError(fleet.run()));
+  CHECK(!fleet.getValid(0) && fleet.getValid(1));
+  CHECK(fleet.getEpoch(epoch));
+  CHECK(epoch == 1706708731UL);
+}
+
+static void testSnapshot()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  for (uint8_t i = 0; i < gbj_ds1307::MEMORY_SIZE; i++)
+  {
+    sim.regs[0x08 + i] = i;
+  }
+  uint8_t image[gbj_ds1307::IMAGE_SIZE];
+  // Whole register space read in the fewest bursts
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.snapshot(image)));
+  CHECK(memcmp(image + 3, sim.regs, 64) == 0);
+  if (GBJ_DS1307_WIRE_BUFFER == 32)
+  {
+    CHECK_COST(4, 2 + 64);
+  }
+  else
+  {
+    CHECK_COST(2, 1 + 64);
+  }
+  // Image written back to a chip after power loss in the fewest bursts
+  sim.reset();
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.restore(image)));
+  CHECK(memcmp(image + 3, sim.regs, 64) == 0);
+  if (GBJ_DS1307_WIRE_BUFFER == 32)
+  {
+    CHECK_COST(3, 3 + 64);
+  }
+  else
+  {
+    CHECK_COST(1, 1 + 64);
+  }
+  // Running clock kept while the rest is restored
+  sim.regs[0x07] = 0x00;
+  sim.regs[0x08] = 0xAA;
+  sim.tick(5);
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.restore(image, false)));
+  CHECK(sim.regs[0x00] == 0x35 && sim.regs[0x07] == image[3 + 0x07]);
+  CHECK(sim.regs[0x08] == 0x00);
+  if (GBJ_DS1307_WIRE_BUFFER == 32)
+  {
+    CHECK_COST(2, 2 + 64 - 0x07);
+  }
+  else
+  {
+    CHECK_COST(1, 1 + 64 - 0x07);
+  }
+  // Image with wrong header is refused without bus communication
+  image[0] ^= 0xFF;
+  sim.resetCounters();
+  CHECK(device.restore(image) == device.ERROR_POSITION);
+  CHECK_COST(0, 0);
+}
+
+static void testBusTuning()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.setBusTuning(true);
+  // Reference reading at slow clock and verified readings at fast clock
+  sim.resetCounters();
+  CHECK(device.isSuccess(device.begin()));
+  CHECK(device.getBusTuned());
+  CHECK(device.getBusClock() == device.CLOCK_400KHZ);
+  if (GBJ_DS1307_WIRE_BUFFER == 32)
+  {
+    CHECK_COST(4 * 4 + 2, 4 * (2 + 56) + (1 + 8));
+  }
+  else
+  {
+    CHECK_COST(4 * 2 + 2, 4 * (1 + 56) + (1 + 8));
+  }
+  // Sporadic errors keep the fast clock
+  gbj_ds1307::Datetime dt;
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    for (uint8_t j = 0; j < 2; j++)
+    {
+      sim.failAt = sim.starts + 1;
+      CHECK(device.isError(device.getDateTime(dt)));
+    }
+    CHECK(device.isSuccess(device.getDateTime(dt)));
+  }
+  CHECK(device.getBusClock() == device.CLOCK_400KHZ);
+  // Consecutive errors fall back to the slow clock
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    sim.failAt = sim.starts + 1;
+    CHECK(device.isError(device.getDateTime(dt)));
+  }
+  CHECK(!device.getBusTuned());
+  CHECK(device.getBusClock() == device.CLOCK_100KHZ);
+  // Failed fast reading keeps the slow clock without failing the start
+  gbj_ds1307 failed = gbj_ds1307();
+  failed.setBusTuning(true);
+  sim.failAt = sim.starts + (GBJ_DS1307_WIRE_BUFFER == 32 ? 4 : 2) + 1;
+  CHECK(failed.isSuccess(failed.begin()));
+  CHECK(!failed.getBusTuned());
+  CHECK(failed.getBusClock() == failed.CLOCK_100KHZ);
+}
+
+static void testBootState()
+{
+  startChip();
+  gbj_ds1307 device = gbj_ds1307();
+  device.begin();
+  device.configSqwRate(device.SQW_RATE_4KHZ);
+  device.commit();
+  CHECK(device.isSuccess(device.stopClock()));
+  gbj_ds1307::BootState state = device.getBootState();
+  // Restart without any bus communication
+  gbj_ds1307 rebooted = gbj_ds1307();
+  sim.resetCounters();
+  CHECK(rebooted.isSuccess(rebooted.begin(state)));
+  CHECK_COST(0, 0);
+  CHECK(!rebooted.getClockEnabled());
+  CHECK(rebooted.getSqwRate() == rebooted.SQW_RATE_4KHZ);
+  // The first datetime reading communicates
+  gbj_ds1307::Datetime dt;
+  sim.resetCounters();
+  CHECK(rebooted.isSuccess(rebooted.getDateTime(dt)));
+  CHECK(dt.minute == 45 && dt.second == 30);
+  CHECK_COST(2, 1 + 8);
+  // Tuned bus clock is set right away
+  state.busTuned = true;
+  gbj_ds1307 tuned = gbj_ds1307();
+  sim.resetCounters();
+  CHECK(tuned.isSuccess(tuned.begin(state)));
+  CHECK(tuned.getBusTuned());
+  CHECK(tuned.getBusClock() == tuned.CLOCK_400KHZ);
+  CHECK_COST(0, 0);
+}
+
+static void testParseIso()
+{
+  gbj_ds1307::Datetime dt;
+  CHECK(gbj_ds1307::parseIso(dt, "2024-01-31T13:45:30"));
+  CHECK(dt.year == 2024 && dt.month == 1 && dt.day == 31 && dt.weekday == 3);
+  CHECK(gbj_ds1307::parseIso(dt, "2024-02-29 00:00:00"));
+  CHECK(dt.weekday == 4);
+  CHECK(gbj_ds1307::parseIso(dt, "2000-02-29T00:00:00"));
+  CHECK(gbj_ds1307::parseIso(dt, "2099-12-31T23:59:59.999+01:00"));
+  const char *invalid[] = {
+    "2024-02-31T10:00:00", "2023-02-29T10:00:00", "2024-04-31T10:00:00",
+    "2024-00-10T10:00:00", "2024-01-00T10:00:00", "2024-01-01T24:00:00",
+    "1999-12-31T23:59:59", "2024-01-01X10:00:00", "2024-01-01T10:00",
+  };
+  for (uint8_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+  {
+    CHECK(!gbj_ds1307::parseIso(dt, invalid[i]));
+  }
+}
+
+static void testCivilFromDays()
+{
+  uint16_t year;
+  uint8_t month, day;
+  gbj_ds1307::civilFromDays(0, year, month, day);
+  CHECK(year == 1970 && month == 1 && day == 1);
+  gbj_ds1307::civilFromDays(11016, year, month, day);
+  CHECK(year == 2000 && month == 2 && day == 29);
+  gbj_ds1307::civilFromDays(1706708730UL / 86400, year, month, day);
+  CHECK(year == 2024 && month == 1 && day == 31);
+  gbj_ds1307::civilFromDays(47481, year, month, day);
+  CHECK(year == 2099 && month == 12 && day == 31);
+}
+
+int main()
+{
+  testBenchmarkCosts();
+  testDatetimeRoundTrip();
+  testNvramBursts();
+  testBusError();
+#ifdef GBJ_DS1307_STATS
+  testStats();
+#endif
+  testCacheResync();
+  testSqw();
+  testSyncTimestamp();
+  testAsyncRead();
+  testClockSwitch();
+  testPendingCommit();
+  testBatch();
+  testRecord();
+  testPersistenceWithMirror();
+  testLogValidation();
+  testVerifiedRead();
+  testDrift();
+  testSleepWake();
+  testSleepPeriod();
+  testConfigDateTime();
+  testBcdDatetime();
+  testEpochRoundTrip();
+  testFleet();
+  testSnapshot();
+  testBusTuning();
+  testBootState();
+  testParseIso();
+  testCivilFromDays();
+  printf("%u checks, %u failures\n", checks, failures);
+  return failures ? 1 : 0;
+}